@@ -386,6 +386,22 @@ static uint64_t superblock_pos[4] = {
     1048576ULL * 1048576ULL / 4
 };
 
+/* Only the first superblock has to be there, see btrfs_read_superblock.  */
+#define BTRFS_PROBE_SIZE (64 / 4 * BTRFS_DEFAULT_BLOCK_SIZE + sizeof (struct btrfs_superblock))
+
+static fsw_status_t fsw_btrfs_volume_probe(void *head, fsw_u32 head_size)
+{
+    struct btrfs_superblock *sb;
+
+    if (head_size < BTRFS_PROBE_SIZE)
+        return FSW_UNSUPPORTED;
+    sb = (struct btrfs_superblock *)((uint8_t *)head + superblock_pos[0] * BTRFS_DEFAULT_BLOCK_SIZE);
+    if (!fsw_memeq (sb->signature, GRUB_BTRFS_SIGNATURE,
+                sizeof (GRUB_BTRFS_SIGNATURE) - 1))
+        return FSW_UNSUPPORTED;
+    return FSW_SUCCESS;
+}
+
 static fsw_status_t fsw_btrfs_read_logical(struct fsw_btrfs_volume *vol,
         uint64_t addr, void *buf, fsw_size_t size, int rdepth, int cache_level);
 
@@ -1876,5 +1892,8 @@ struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(btrfs) = {
     fsw_btrfs_dir_lookup,
     fsw_btrfs_dir_read,
     fsw_btrfs_readlink,
+    NULL,
+    BTRFS_PROBE_SIZE,
+    fsw_btrfs_volume_probe,
 };
 
@@ -43,8 +43,23 @@
 // functions
 
 static void fsw_blockcache_free(struct fsw_volume *vol);
+static void fsw_lookup_cache_free(struct fsw_volume *vol);
+static void fsw_dnode_pool_unlink(struct fsw_volume *vol, struct fsw_dnode *dno);
+static void fsw_dnode_pool_drain(struct fsw_volume *vol);
+static void fsw_arena_release(struct fsw_volume *vol);
 
-#define MAX_CACHE_LEVEL (5)
+/**
+ * Default share of block cache entries protected from eviction by blocks of other
+ * levels, in percent, indexed by cache level. Used when the file system driver does
+ * not set vol->bcache_quota.
+ */
+static fsw_u32 fsw_bcache_default_quota[FSW_MAX_CACHE_LEVEL+1] = { 25, 20, 25, 10, 10, 10 };
+
+/**
+ * Number of bytes used by the block caches of all mounted volumes, and its high-water mark.
+ */
+static fsw_u32 fsw_bcache_global_bytes = 0;
+static fsw_u32 fsw_bcache_global_peak_bytes = 0;
 
 
 /**
@@ -82,6 +97,7 @@ fsw_status_t fsw_mount(void *host_data,
     vol->host_table     = host_table;
     vol->fstype_table   = fstype_table;
     vol->host_string_type = host_table->native_string_type;
+    vol->bcache_budget  = host_table->bcache_volume_budget;
 
     // let the fs driver mount the file system
     status = vol->fstype_table->volume_mount(vol);
@@ -103,18 +119,24 @@ errorexit:
  * called by the host driver when a volume is no longer needed. It is also called
  * by the core after a failed mount to clean up any allocated memory.
  *
- * Note that all dnodes must have been released before calling this function.
+ * Note that all dnodes must have been released before calling this function. Their
+ * structures and names live in the volume's arena, which is freed here as a whole.
  */
 
 void fsw_unmount(struct fsw_volume *vol)
 {
+    fsw_lookup_cache_free(vol);
+    fsw_dnode_pool_drain(vol);
     if (vol->root)
         fsw_dnode_release(vol->root);
     // TODO: check that no other dnodes are still around
 
     vol->fstype_table->volume_free(vol);
 
+    if (vol->dnode_hash != NULL)
+        fsw_free(vol->dnode_hash);
     fsw_blockcache_free(vol);
+    fsw_arena_release(vol);
     fsw_strfree(&vol->label);
     fsw_free(vol);
 }
@@ -161,19 +183,370 @@ void fsw_set_blocksize(struct fsw_volume *vol, fsw_u32 phys_blocksize, fsw_u32 l
     vol->log_blocksize = log_blocksize;
 }
 
+/**
+ * Compute the hash bucket for a physical block number. Block numbers are mostly
+ * sequential, but some file systems place metadata at large power-of-2 strides
+ * (e.g. one inode table per block group), so the bits are mixed before masking.
+ */
+
+static fsw_u32 fsw_blockcache_hash(struct fsw_volume *vol, fsw_u64 phys_bno)
+{
+    fsw_u32 h;
+
+    h = (fsw_u32)phys_bno ^ (fsw_u32)FSW_U64_SHR(phys_bno, 32);
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return h & vol->bcache_hash_mask;
+}
+
+/**
+ * Find the block cache entry holding a physical block. Returns the index of the
+ * entry, or FSW_BCACHE_NIL if the block is not cached.
+ */
+
+static fsw_u32 fsw_blockcache_find(struct fsw_volume *vol, fsw_u64 phys_bno)
+{
+    fsw_u32 i;
+
+    for (i = vol->bcache_hash[fsw_blockcache_hash(vol, phys_bno)]; i != FSW_BCACHE_NIL; i = vol->bcache[i].hash_next) {
+        if (vol->bcache[i].phys_bno == phys_bno)
+            return i;
+    }
+    return FSW_BCACHE_NIL;
+}
+
+/**
+ * Remove a block cache entry from its hash chain. The entry keeps its data buffer.
+ */
+
+static void fsw_blockcache_unhash(struct fsw_volume *vol, fsw_u32 i)
+{
+    fsw_u32 *link;
+
+    link = &vol->bcache_hash[fsw_blockcache_hash(vol, vol->bcache[i].phys_bno)];
+    while (*link != i)
+        link = &vol->bcache[*link].hash_next;
+    *link = vol->bcache[i].hash_next;
+    vol->bcache[i].phys_bno = (fsw_u64)FSW_INVALID_BNO;
+    vol->bcache_level_count[vol->bcache[i].cache_level]--;
+}
+
+/**
+ * Choose a block cache entry to discard. This is a CLOCK algorithm: the hand sweeps
+ * over the cache, giving blocks that were hit since the last sweep a second chance.
+ *
+ * Each cache level owns a share of the cache (vol->bcache_quota). A level that holds
+ * fewer blocks than its share is protected, so streaming a large file at level 0
+ * recycles its own blocks instead of pushing out directory and inode blocks. Only if
+ * no block of a level at or over its share can be discarded, any unused block is taken.
+ *
+ * Returns the index of the entry, which has been removed from the hash table, or
+ * FSW_BCACHE_NIL if all entries are in use.
+ */
+
+static fsw_u32 fsw_blockcache_evict(struct fsw_volume *vol)
+{
+    fsw_u32 i, level, steps, pass;
+    fsw_u32 quota_slots[FSW_MAX_CACHE_LEVEL+1];
+
+    for (level = 0; level <= FSW_MAX_CACHE_LEVEL; level++)
+        quota_slots[level] = (vol->bcache_size * vol->bcache_quota[level]) / 100;
+
+    for (pass = 0; pass < 2; pass++) {
+        // sweep twice around, so that blocks losing their second chance can be taken
+        for (steps = 0; steps < 2 * vol->bcache_size; steps++) {
+            i = vol->bcache_hand;
+            if (++vol->bcache_hand >= vol->bcache_size)
+                vol->bcache_hand = 0;
+
+            if (vol->bcache[i].refcount > 0 || vol->bcache[i].phys_bno == (fsw_u64)FSW_INVALID_BNO)
+                continue;   // in use or on the free list
+            level = vol->bcache[i].cache_level;
+            if (pass == 0 && vol->bcache_level_count[level] < quota_slots[level])
+                continue;   // protected level
+            if (vol->bcache[i].recent) {
+                vol->bcache[i].recent = 0;
+                continue;
+            }
+
+            fsw_blockcache_unhash(vol, i);
+            vol->stats.cache_evictions++;
+            return i;
+        }
+    }
+
+    return FSW_BCACHE_NIL;
+}
+
+/**
+ * Account for memory taken (positive delta) or given back (negative delta) by a
+ * volume's block cache, updating the per-volume and global high-water marks.
+ */
+
+static void fsw_blockcache_charge(struct fsw_volume *vol, fsw_s32 delta)
+{
+    vol->bcache_bytes += delta;
+    fsw_bcache_global_bytes += delta;
+    if (vol->bcache_bytes > vol->bcache_peak_bytes)
+        vol->bcache_peak_bytes = vol->bcache_bytes;
+    if (fsw_bcache_global_bytes > fsw_bcache_global_peak_bytes)
+        fsw_bcache_global_peak_bytes = fsw_bcache_global_bytes;
+}
+
+/**
+ * Check if the block cache would exceed the volume's or the global budget after
+ * allocating another extra_bytes.
+ */
+
+static int fsw_blockcache_over_budget(struct fsw_volume *vol, fsw_u32 extra_bytes)
+{
+    if (vol->bcache_budget > 0 && vol->bcache_bytes + extra_bytes > vol->bcache_budget)
+        return 1;
+    if (vol->host_table->bcache_global_budget > 0 &&
+        fsw_bcache_global_bytes + extra_bytes > vol->host_table->bcache_global_budget)
+        return 1;
+    return 0;
+}
+
+/**
+ * Give memory back while the block cache is over budget. Buffers of entries on the
+ * free list go first, then unused blocks chosen by the normal eviction order. Blocks
+ * that are in use stay, so the cache may remain over budget until they are released.
+ */
+
+static void fsw_blockcache_shrink(struct fsw_volume *vol)
+{
+    fsw_u32 i;
+
+    for (i = vol->bcache_free; i != FSW_BCACHE_NIL && fsw_blockcache_over_budget(vol, 0); i = vol->bcache[i].hash_next) {
+        if (vol->bcache[i].data != NULL) {
+            fsw_free(vol->bcache[i].data);
+            vol->bcache[i].data = NULL;
+            fsw_blockcache_charge(vol, -(fsw_s32)vol->phys_blocksize);
+        }
+    }
+
+    while (fsw_blockcache_over_budget(vol, 0)) {
+        i = fsw_blockcache_evict(vol);
+        if (i == FSW_BCACHE_NIL)
+            break;
+        fsw_free(vol->bcache[i].data);
+        vol->bcache[i].data = NULL;
+        fsw_blockcache_charge(vol, -(fsw_s32)vol->phys_blocksize);
+        vol->bcache[i].hash_next = vol->bcache_free;
+        vol->bcache_free = i;
+    }
+}
+
+/**
+ * Create or enlarge the block cache array and rebuild the hash table for it.
+ * Existing entries keep their index and data buffers. New entries are put
+ * on the free list.
+ */
+
+static fsw_status_t fsw_blockcache_resize(struct fsw_volume *vol, fsw_u32 new_bcache_size)
+{
+    fsw_status_t    status;
+    fsw_u32         i, h, old_bcache_size, hash_size;
+    struct fsw_blockcache *new_bcache;
+    fsw_u32         *new_hash;
+
+    old_bcache_size = (vol->bcache != NULL) ? vol->bcache_size : 0;
+
+    for (hash_size = 16; hash_size < new_bcache_size; hash_size <<= 1)
+        ;
+    status = fsw_alloc(new_bcache_size * sizeof(struct fsw_blockcache), &new_bcache);
+    if (status)
+        return status;
+    status = fsw_alloc(hash_size * sizeof(fsw_u32), &new_hash);
+    if (status) {
+        fsw_free(new_bcache);
+        return status;
+    }
+
+    if (old_bcache_size > 0)
+        fsw_memcpy(new_bcache, vol->bcache, old_bcache_size * sizeof(struct fsw_blockcache));
+    for (i = old_bcache_size; i < new_bcache_size; i++) {
+        new_bcache[i].refcount = 0;
+        new_bcache[i].cache_level = 0;
+        new_bcache[i].recent = 0;
+        new_bcache[i].phys_bno = (fsw_u64)FSW_INVALID_BNO;
+        new_bcache[i].data = NULL;
+    }
+
+    // switch caches
+    if (vol->bcache != NULL)
+        fsw_free(vol->bcache);
+    if (vol->bcache_hash != NULL)
+        fsw_free(vol->bcache_hash);
+    if (old_bcache_size > 0)
+        fsw_blockcache_charge(vol, -(fsw_s32)(old_bcache_size * sizeof(struct fsw_blockcache)
+                                              + (vol->bcache_hash_mask + 1) * sizeof(fsw_u32)));
+    fsw_blockcache_charge(vol, new_bcache_size * sizeof(struct fsw_blockcache) + hash_size * sizeof(fsw_u32));
+    vol->bcache = new_bcache;
+    vol->bcache_size = new_bcache_size;
+    vol->bcache_hash = new_hash;
+    vol->bcache_hash_mask = hash_size - 1;
+
+    // rebuild the hash chains and the free list
+    for (i = 0; i < hash_size; i++)
+        new_hash[i] = FSW_BCACHE_NIL;
+    vol->bcache_free = FSW_BCACHE_NIL;
+    for (i = new_bcache_size; i-- > 0; ) {
+        if (new_bcache[i].phys_bno == (fsw_u64)FSW_INVALID_BNO) {
+            new_bcache[i].hash_next = vol->bcache_free;
+            vol->bcache_free = i;
+        } else {
+            h = fsw_blockcache_hash(vol, new_bcache[i].phys_bno);
+            new_bcache[i].hash_next = new_hash[h];
+            new_hash[h] = i;
+        }
+    }
+
+    return FSW_SUCCESS;
+}
+
+/**
+ * Create the block cache on first use.
+ */
+
+static fsw_status_t fsw_blockcache_setup(struct fsw_volume *vol)
+{
+    fsw_u32         i, j;
+
+    if (vol->bcache != NULL)
+        return FSW_SUCCESS;
+
+    // use the default level shares unless the driver set its own
+    for (j = 0, i = 0; i <= FSW_MAX_CACHE_LEVEL; i++)
+        j += vol->bcache_quota[i];
+    if (j == 0)
+        fsw_memcpy(vol->bcache_quota, fsw_bcache_default_quota, sizeof(vol->bcache_quota));
+
+    // create the cache, using the initial size set by the driver if present
+    return fsw_blockcache_resize(vol, vol->bcache_size > 16 ? vol->bcache_size : 16);
+}
+
+/**
+ * Read a run of blocks through the host driver, counting the call, the bytes
+ * and, if the host provides a clock, the time spent. A count of one uses
+ * read_block, larger counts need read_blocks.
+ */
+
+static fsw_status_t fsw_host_read(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer)
+{
+    fsw_status_t    status;
+    fsw_u64         start = 0;
+
+    if (vol->host_table->clock != NULL)
+        start = vol->host_table->clock();
+    if (count == 1)
+        status = vol->host_table->read_block(vol, phys_bno, buffer);
+    else
+        status = vol->host_table->read_blocks(vol, phys_bno, count, buffer);
+    if (vol->host_table->clock != NULL)
+        vol->stats.host_read_time += vol->host_table->clock() - start;
+
+    vol->stats.host_read_calls++;
+    vol->stats.host_read_bytes += (fsw_u64)count * vol->phys_blocksize;
+    return status;
+}
+
+/**
+ * Put a block that is not cached yet into a cache entry. The data is copied from
+ * src, or read from the disk if src is NULL. The new entry is not in use
+ * (refcount is zero). Returns the index of the entry in *index_out.
+ */
+
+static fsw_status_t fsw_blockcache_load(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 cache_level,
+                                        void *src, fsw_u32 *index_out)
+{
+    fsw_status_t    status;
+    fsw_u32         i, j;
+
+    // take a free entry, or discard an unused one; when over budget, prefer
+    //  reusing the buffer of an unused block to allocating a new buffer
+    i = vol->bcache_free;
+    if (i != FSW_BCACHE_NIL && vol->bcache[i].data == NULL &&
+        fsw_blockcache_over_budget(vol, vol->phys_blocksize)) {
+        i = fsw_blockcache_evict(vol);
+        if (i == FSW_BCACHE_NIL)
+            i = vol->bcache_free;
+    }
+    if (i == FSW_BCACHE_NIL) {
+        i = fsw_blockcache_evict(vol);
+        if (i == FSW_BCACHE_NIL) {
+            // enlarge the cache
+            status = fsw_blockcache_resize(vol, vol->bcache_size << 1);
+            if (status)
+                return status;
+            vol->stats.cache_grows++;
+            i = vol->bcache_free;
+        }
+    }
+    if (i == vol->bcache_free)
+        vol->bcache_free = vol->bcache[i].hash_next;
+
+    // get the data
+    if (vol->bcache[i].data == NULL) {
+        status = fsw_alloc(vol->phys_blocksize, &vol->bcache[i].data);
+        if (status)
+            goto errorexit;
+        fsw_blockcache_charge(vol, vol->phys_blocksize);
+    }
+    if (src != NULL) {
+        fsw_memcpy(vol->bcache[i].data, src, vol->phys_blocksize);
+    } else {
+        status = fsw_host_read(vol, phys_bno, 1, vol->bcache[i].data);
+        if (status)
+            goto errorexit;
+    }
+
+    vol->bcache[i].phys_bno = phys_bno;
+    vol->bcache[i].cache_level = cache_level;
+    vol->bcache[i].recent = 0;
+    vol->bcache[i].refcount = 0;
+    vol->bcache_level_count[cache_level]++;
+    j = fsw_blockcache_hash(vol, phys_bno);
+    vol->bcache[i].hash_next = vol->bcache_hash[j];
+    vol->bcache_hash[j] = i;
+    *index_out = i;
+    return FSW_SUCCESS;
+
+errorexit:
+    // give the entry back to the free list
+    vol->bcache[i].hash_next = vol->bcache_free;
+    vol->bcache_free = i;
+    return status;
+}
+
 /**
  * Get a block of data from the disk. This function is called by the file system driver
  * or by core functions. It calls through to the host driver's device access routine.
  * Given a physical block number, it reads the block into memory (or fetches it from the
  * block cache) and returns the address of the memory buffer. The caller should provide
- * an indication of how important the block is in the cache_level parameter. Blocks with
- * a low level are purged first. Some suggestions for cache levels:
+ * an indication of how important the block is in the cache_level parameter. Each level
+ * is guaranteed a share of the cache, and blocks of levels that use more than their share
+ * are purged first. Some suggestions for cache levels:
  *
  *  - 0: File data
  *  - 1: Directory data, symlink data
  *  - 2: File system metadata
  *  - 3..5: File system metadata with a high rate of access
  *
+ * Cached blocks are found through a hash table keyed by the physical block number,
+ * so the cost of a hit does not depend on the size of the cache.
+ *
+ * The memory used by the cache is limited by vol->bcache_budget (initialized from the
+ * host table, may be changed by the file system driver) and by the host's global budget.
+ * When over budget, a miss reuses the buffer of an unused block instead of allocating
+ * a new one, and unused buffers are freed. Blocks in use are never discarded, so the
+ * budget can be exceeded while the driver holds more blocks than fit into it.
+ *
+ * If the host driver provides a block_get function, it is asked first and may serve
+ * the block from its own cache.
+ *
  * If this function returns successfully, the returned data pointer is valid until the
  * caller calls fsw_block_release.
  */
@@ -181,154 +554,510 @@ void fsw_set_blocksize(struct fsw_volume *vol, fsw_u32 phys_blocksize, fsw_u32 l
 fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out)
 {
     fsw_status_t    status;
-    fsw_u32         i, discard_level, new_bcache_size;
-    struct fsw_blockcache *new_bcache;
+    fsw_u32         i;
+
+    // let the host driver serve the block from its own cache if it can
+    if (vol->host_table->block_get != NULL) {
+        status = vol->host_table->block_get(vol, phys_bno, cache_level, buffer_out);
+        if (status != FSW_UNSUPPORTED) {
+            vol->stats.host_block_gets++;
+            return status;
+        }
+    }
+
+    if (cache_level > FSW_MAX_CACHE_LEVEL)
+        cache_level = FSW_MAX_CACHE_LEVEL;
+
+    status = fsw_blockcache_setup(vol);
+    if (status)
+        return status;
+
+    // check block cache
+    i = fsw_blockcache_find(vol, phys_bno);
+    if (i != FSW_BCACHE_NIL) {
+        // cache hit!
+        if (vol->bcache[i].cache_level < cache_level) {
+            // promote the entry
+            vol->bcache_level_count[vol->bcache[i].cache_level]--;
+            vol->bcache_level_count[cache_level]++;
+            vol->bcache[i].cache_level = cache_level;
+        }
+        vol->bcache[i].recent = 1;
+        vol->bcache[i].refcount++;
+        vol->stats.cache_hits[cache_level]++;
+        *buffer_out = vol->bcache[i].data;
+        return FSW_SUCCESS;
+    }
+
+    // read the block into a new entry
+    vol->stats.cache_misses[cache_level]++;
+    status = fsw_blockcache_load(vol, phys_bno, cache_level, NULL, &i);
+    if (status)
+        return status;
+    vol->bcache[i].refcount = 1;
+    *buffer_out = vol->bcache[i].data;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Read a run of blocks into the block cache ahead of their use. This function is
+ * called by the file system driver or by core functions when they know which blocks
+ * they will need next, e.g. the rest of a directory extent or a table read at mount
+ * time. Nothing is done if the first block is already cached. Cached blocks at the end
+ * of the run are skipped, and the rest is read with a single call to the host driver's
+ * read_blocks function.
+ *
+ * This is only a hint. If the host driver has no read_blocks function or an error
+ * occurs, nothing is read and fsw_block_get reads the blocks later as usual.
+ */
+
+void fsw_block_readahead(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, fsw_u32 count, fsw_u32 cache_level)
+{
+    fsw_u8          *run_buffer;
+    fsw_u32         i, j, max_count;
+
+    if (vol->host_table->read_blocks == NULL)
+        return;
+    if (cache_level > FSW_MAX_CACHE_LEVEL)
+        cache_level = FSW_MAX_CACHE_LEVEL;
+    if (fsw_blockcache_setup(vol))
+        return;
+
+    // don't read more than fits into the cache next to the blocks in use
+    max_count = FSW_READAHEAD_MAX_BYTES / vol->phys_blocksize;
+    if (max_count > vol->bcache_size / 2)
+        max_count = vol->bcache_size / 2;
+    if (count > max_count)
+        count = max_count;
+
+    // skip runs that were read ahead already, and trim cached blocks at the end
+    if (count == 0 || fsw_blockcache_find(vol, phys_bno) != FSW_BCACHE_NIL)
+        return;
+    while (count > 0 && fsw_blockcache_find(vol, phys_bno + count - 1) != FSW_BCACHE_NIL)
+        count--;
+    if (count < 2)
+        return;     // not worth it, fsw_block_get reads single blocks
+
+    if (fsw_alloc(count * vol->phys_blocksize, &run_buffer))
+        return;
+    if (fsw_host_read(vol, phys_bno, count, run_buffer) == FSW_SUCCESS) {
+        for (i = 0; i < count; i++) {
+            if (fsw_blockcache_find(vol, phys_bno + i) != FSW_BCACHE_NIL)
+                continue;
+            if (fsw_blockcache_load(vol, phys_bno + i, cache_level,
+                                    run_buffer + i * vol->phys_blocksize, &j))
+                break;
+            vol->stats.readahead_blocks++;
+        }
+    }
+    fsw_free(run_buffer);
+}
+
+/**
+ * Releases a disk block. This function must be called to release disk blocks returned
+ * from fsw_block_get.
+ */
+
+void fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, void *buffer)
+{
+    fsw_u32 i;
+
+    // blocks handed out by the host driver go back to it
+    if (vol->host_table->block_release != NULL &&
+        vol->host_table->block_release(vol, phys_bno, buffer) != FSW_UNSUPPORTED)
+        return;
+
+    if (vol->bcache == NULL)
+        return;
+
+    // update block cache
+    i = fsw_blockcache_find(vol, phys_bno);
+    if (i != FSW_BCACHE_NIL && vol->bcache[i].refcount > 0) {
+        vol->bcache[i].refcount--;
+
+        // give memory back if blocks in use pushed the cache over budget
+        if (vol->bcache[i].refcount == 0 && fsw_blockcache_over_budget(vol, 0))
+            fsw_blockcache_shrink(vol);
+    }
+}
 
-    // TODO: allow the host driver to do its own caching; just call through if
-    //  the appropriate function pointers are set
+/**
+ * Read a run of physical blocks straight into the caller's buffer, bypassing the
+ * block cache. Used for bulk file data, which would only be copied twice and push
+ * metadata out of the cache. Uses a single host call if the host driver supports it.
+ */
+
+static fsw_status_t fsw_block_read_direct(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, fsw_u8 *buffer)
+{
+    fsw_status_t    status;
 
-    if (cache_level > MAX_CACHE_LEVEL)
-        cache_level = MAX_CACHE_LEVEL;
+    if (vol->host_table->read_blocks != NULL && count > 1)
+        return fsw_host_read(vol, phys_bno, count, buffer);
 
-    if (vol->bcache_size > 0 && vol->bcache == NULL) {
-        /* driver set the initial cache size */
-        status = fsw_alloc(vol->bcache_size * sizeof(struct fsw_blockcache), &vol->bcache);
-        if(status)
+    for (; count > 0; count--, phys_bno++, buffer += vol->phys_blocksize) {
+        status = fsw_host_read(vol, phys_bno, 1, buffer);
+        if (status)
             return status;
+    }
+    return FSW_SUCCESS;
+}
+
+/**
+ * Get the number of bytes used by the block caches of all mounted volumes and the
+ * highest number seen so far. The per-volume numbers are in vol->bcache_bytes and
+ * vol->bcache_peak_bytes. Either pointer may be NULL.
+ */
+
+void fsw_blockcache_global_usage(fsw_u32 *bytes_out, fsw_u32 *peak_bytes_out)
+{
+    if (bytes_out != NULL)
+        *bytes_out = fsw_bcache_global_bytes;
+    if (peak_bytes_out != NULL)
+        *peak_bytes_out = fsw_bcache_global_peak_bytes;
+}
+
+/**
+ * Release the block cache. Called internally when changing block sizes and when
+ * unmounting the volume. It frees all data occupied by the generic block cache.
+ */
+
+static void fsw_blockcache_free(struct fsw_volume *vol)
+{
+    fsw_u32 i;
+
+    if (vol->bcache != NULL) {
         for (i = 0; i < vol->bcache_size; i++) {
-            vol->bcache[i].refcount = 0;
-            vol->bcache[i].cache_level = 0;
-            vol->bcache[i].phys_bno = (fsw_u64)FSW_INVALID_BNO;
-            vol->bcache[i].data = NULL;
+            if (vol->bcache[i].data != NULL)
+                fsw_free(vol->bcache[i].data);
         }
-        i = 0;
-        goto miss;
+        fsw_free(vol->bcache);
+        vol->bcache = NULL;
+    }
+    if (vol->bcache_hash != NULL) {
+        fsw_free(vol->bcache_hash);
+        vol->bcache_hash = NULL;
     }
+    vol->bcache_size = 0;
+    vol->bcache_hand = 0;
+    fsw_memzero(vol->bcache_level_count, sizeof(vol->bcache_level_count));
+    fsw_blockcache_charge(vol, -(fsw_s32)vol->bcache_bytes);
+}
 
-    // check block cache
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == phys_bno) {
-            // cache hit!
-            if (vol->bcache[i].cache_level < cache_level)
-                vol->bcache[i].cache_level = cache_level;  // promote the entry
-            vol->bcache[i].refcount++;
-            *buffer_out = vol->bcache[i].data;
-            return FSW_SUCCESS;
+/**
+ * Get the object size of an arena size class. Class 0 holds the file system's
+ * dnode structures, classes 1 and up hold names of 16, 32, 64, 128 and 256 bytes.
+ */
+
+static fsw_u32 fsw_arena_class_size(struct fsw_volume *vol, int cls)
+{
+    if (cls == 0)
+        return (vol->fstype_table->dnode_struct_size + 7) & ~7;
+    return 8 << cls;
+}
+
+/**
+ * Get the arena size class for a name of the given size in bytes, or -1 if the
+ * name is too large for the arena.
+ */
+
+static int fsw_arena_name_class(fsw_u32 size)
+{
+    int             cls;
+
+    for (cls = 1; cls < FSW_ARENA_CLASSES; cls++) {
+        if (size <= (fsw_u32)(8 << cls))
+            return cls;
+    }
+    return -1;
+}
+
+/**
+ * Allocate an object of an arena size class. Objects are carved from chunks of
+ * FSW_ARENA_CHUNK_SIZE bytes that belong to the volume; freed objects go onto a
+ * per-class free list and are handed out again. The memory is not cleared.
+ */
+
+static fsw_status_t fsw_arena_alloc(struct fsw_volume *vol, int cls, void **ptr_out)
+{
+    fsw_status_t    status;
+    struct fsw_arena_chunk *chunk;
+    fsw_u32         obj_size, chunk_size, count, i;
+    fsw_u8          *obj;
+
+    if (vol->arena_free[cls] == NULL) {
+        obj_size = fsw_arena_class_size(vol, cls);
+        count = (FSW_ARENA_CHUNK_SIZE - sizeof(struct fsw_arena_chunk)) / obj_size;
+        if (count == 0)
+            count = 1;
+        chunk_size = sizeof(struct fsw_arena_chunk) + count * obj_size;
+        status = fsw_alloc(chunk_size, &chunk);
+        if (status)
+            return status;
+        chunk->next = vol->arena_chunks;
+        vol->arena_chunks = chunk;
+        vol->arena_chunk_count++;
+
+        // thread the new objects onto the free list
+        obj = (fsw_u8 *)(chunk + 1);
+        for (i = 0; i < count; i++, obj += obj_size) {
+            *(void **)obj = vol->arena_free[cls];
+            vol->arena_free[cls] = obj;
         }
     }
 
-    // find a free entry in the cache table
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == (fsw_u64)FSW_INVALID_BNO)
-            break;
+    *ptr_out = vol->arena_free[cls];
+    vol->arena_free[cls] = *(void **)*ptr_out;
+    vol->arena_allocs++;
+    return FSW_SUCCESS;
+}
+
+static void fsw_arena_free(struct fsw_volume *vol, int cls, void *ptr)
+{
+    *(void **)ptr = vol->arena_free[cls];
+    vol->arena_free[cls] = ptr;
+}
+
+/**
+ * Release all memory of the volume's arena at once. Called on unmount.
+ */
+
+static void fsw_arena_release(struct fsw_volume *vol)
+{
+    struct fsw_arena_chunk *chunk;
+    int             cls;
+
+    while ((chunk = vol->arena_chunks) != NULL) {
+        vol->arena_chunks = chunk->next;
+        fsw_free(chunk);
     }
-    if (i >= vol->bcache_size) {
-        for (discard_level = 0; discard_level <= MAX_CACHE_LEVEL; discard_level++) {
-            for (i = 0; i < vol->bcache_size; i++) {
-                if (vol->bcache[i].refcount == 0 && vol->bcache[i].cache_level <= discard_level)
-                    break;
-            }
-            if (i < vol->bcache_size)
-                break;
+    for (cls = 0; cls < FSW_ARENA_CLASSES; cls++)
+        vol->arena_free[cls] = NULL;
+}
+
+/**
+ * Copy a string into arena memory, converting it to the given encoding. Only
+ * copies that need no conversion or a widening from ISO 8859-1 to UTF-16 are
+ * placed in the arena; for everything else, FSW_UNSUPPORTED is returned and the
+ * caller falls back to fsw_strdup_coerce. Free the copy with fsw_arena_strfree.
+ */
+
+static fsw_status_t fsw_arena_strdup(struct fsw_volume *vol, struct fsw_string *dest, int type, struct fsw_string *src)
+{
+    fsw_status_t    status;
+    fsw_u32         size;
+    int             cls, i;
+
+    if (src->type == FSW_STRING_TYPE_EMPTY || src->len == 0) {
+        dest->type = type;
+        dest->size = dest->len = 0;
+        dest->data = NULL;
+        return FSW_SUCCESS;
+    }
+
+    if (src->type == type)
+        size = src->size;
+    else if (src->type == FSW_STRING_TYPE_ISO88591 && type == FSW_STRING_TYPE_UTF16)
+        size = src->len * sizeof(fsw_u16);
+    else
+        return FSW_UNSUPPORTED;
+    cls = fsw_arena_name_class(size);
+    if (cls < 0)
+        return FSW_UNSUPPORTED;
+
+    status = fsw_arena_alloc(vol, cls, &dest->data);
+    if (status)
+        return status;
+    dest->type = type;
+    dest->len  = src->len;
+    dest->size = size;
+    if (src->type == type) {
+        fsw_memcpy(dest->data, src->data, size);
+    } else {
+        for (i = 0; i < src->len; i++)
+            ((fsw_u16 *)dest->data)[i] = ((fsw_u8 *)src->data)[i];
+    }
+    return FSW_SUCCESS;
+}
+
+static void fsw_arena_strfree(struct fsw_volume *vol, struct fsw_string *s)
+{
+    if (s->type != FSW_STRING_TYPE_EMPTY && s->data)
+        fsw_arena_free(vol, fsw_arena_name_class(s->size), s->data);
+    s->type = FSW_STRING_TYPE_EMPTY;
+}
+
+/**
+ * Compute the hash bucket for a dnode id. Inode numbers of a directory's entries
+ * tend to be close together, so the bits are mixed before masking.
+ */
+
+static fsw_u32 fsw_dnode_hash(struct fsw_volume *vol, fsw_u64 tree_id, fsw_u64 dnode_id)
+{
+    fsw_u32 h;
+
+    h = (fsw_u32)dnode_id ^ (fsw_u32)FSW_U64_SHR(dnode_id, 32);
+    h ^= ((fsw_u32)tree_id ^ (fsw_u32)FSW_U64_SHR(tree_id, 32)) * 0x9e3779b1;
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return h & vol->dnode_hash_mask;
+}
+
+/**
+ * Create or enlarge the dnode hash table and move all registered dnodes into it.
+ */
+
+static fsw_status_t fsw_dnode_hash_resize(struct fsw_volume *vol, fsw_u32 new_hash_size)
+{
+    fsw_status_t    status;
+    struct fsw_dnode **old_hash, **new_hash, *dno, *next_dno;
+    fsw_u32         i, h, old_hash_size;
+
+    status = fsw_alloc(new_hash_size * sizeof(struct fsw_dnode *), &new_hash);
+    if (status)
+        return status;
+    for (i = 0; i < new_hash_size; i++)
+        new_hash[i] = NULL;
+
+    old_hash = vol->dnode_hash;
+    old_hash_size = (old_hash != NULL) ? vol->dnode_hash_mask + 1 : 0;
+    vol->dnode_hash = new_hash;
+    vol->dnode_hash_mask = new_hash_size - 1;
+
+    for (i = 0; i < old_hash_size; i++) {
+        for (dno = old_hash[i]; dno != NULL; dno = next_dno) {
+            next_dno = dno->next;
+            h = fsw_dnode_hash(vol, dno->tree_id, dno->dnode_id);
+            dno->prev = NULL;
+            dno->next = new_hash[h];
+            if (new_hash[h] != NULL)
+                new_hash[h]->prev = dno;
+            new_hash[h] = dno;
         }
     }
-    if (i >= vol->bcache_size) {
-        // enlarge / create the cache
-        if (vol->bcache_size < 16)
-            new_bcache_size = 16;
-        else
-            new_bcache_size = vol->bcache_size << 1;
-        status = fsw_alloc(new_bcache_size * sizeof(struct fsw_blockcache), &new_bcache);
+    if (old_hash != NULL)
+        fsw_free(old_hash);
+    return FSW_SUCCESS;
+}
+
+/**
+ * Add a new dnode to the hash table of known dnodes. This internal function is used
+ * when a dnode is created to add it to the table that is used to search for existing
+ * dnodes by id. The table grows with the number of dnodes, so lookups stay fast when
+ * many dnodes are alive, e.g. while a large directory is being listed.
+ */
+
+static fsw_status_t fsw_dnode_register(struct fsw_volume *vol, struct fsw_dnode *dno)
+{
+    fsw_status_t    status;
+    fsw_u32         h;
+
+    if (vol->dnode_hash == NULL) {
+        status = fsw_dnode_hash_resize(vol, 64);
         if (status)
             return status;
-        if (vol->bcache_size > 0)
-            fsw_memcpy(new_bcache, vol->bcache, vol->bcache_size * sizeof(struct fsw_blockcache));
-        for (i = vol->bcache_size; i < new_bcache_size; i++) {
-            new_bcache[i].refcount = 0;
-            new_bcache[i].cache_level = 0;
-            new_bcache[i].phys_bno = (fsw_u64)FSW_INVALID_BNO;
-            new_bcache[i].data = NULL;
-        }
-        i = vol->bcache_size;
+    } else if (vol->dnode_count > vol->dnode_hash_mask) {
+        // keep the old table if memory is tight, chains just get longer
+        fsw_dnode_hash_resize(vol, (vol->dnode_hash_mask + 1) << 1);
+    }
+
+    h = fsw_dnode_hash(vol, dno->tree_id, dno->dnode_id);
+    dno->prev = NULL;
+    dno->next = vol->dnode_hash[h];
+    if (vol->dnode_hash[h] != NULL)
+        vol->dnode_hash[h]->prev = dno;
+    vol->dnode_hash[h] = dno;
+    vol->dnode_count++;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Remove a dnode from the hash table of known dnodes.
+ */
+
+static void fsw_dnode_unregister(struct fsw_volume *vol, struct fsw_dnode *dno)
+{
+    if (dno->next)
+        dno->next->prev = dno->prev;
+    if (dno->prev)
+        dno->prev->next = dno->next;
+    else
+        vol->dnode_hash[fsw_dnode_hash(vol, dno->tree_id, dno->dnode_id)] = dno->next;
+    vol->dnode_count--;
+}
+
+/**
+ * Allocate a cleared dnode structure from the volume's arena.
+ */
 
-        // switch caches
-        if (vol->bcache != NULL)
-            fsw_free(vol->bcache);
-        vol->bcache = new_bcache;
-        vol->bcache_size = new_bcache_size;
-    }
-    vol->bcache[i].phys_bno = (fsw_u64)FSW_INVALID_BNO;
-miss:
+static fsw_status_t fsw_dnode_alloc(struct fsw_volume *vol, struct fsw_dnode **dno_out)
+{
+    fsw_status_t    status;
 
-    // read the data
-    if (vol->bcache[i].data == NULL) {
-        status = fsw_alloc(vol->phys_blocksize, &vol->bcache[i].data);
-        if (status)
-            return status;
-    }
-    status = vol->host_table->read_block(vol, phys_bno, vol->bcache[i].data);
+    status = fsw_arena_alloc(vol, 0, (void **)dno_out);
     if (status)
         return status;
-
-    vol->bcache[i].phys_bno = phys_bno;
-    vol->bcache[i].cache_level = cache_level;
-    vol->bcache[i].refcount = 1;
-    *buffer_out = vol->bcache[i].data;
+    fsw_memzero(*dno_out, vol->fstype_table->dnode_struct_size);
     return FSW_SUCCESS;
 }
 
 /**
- * Releases a disk block. This function must be called to release disk blocks returned
- * from fsw_block_get.
+ * Store a copy of the name in a dnode, in the host's string encoding. The copy
+ * comes from the volume's arena when possible.
  */
 
-void fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, void *buffer)
+static fsw_status_t fsw_dnode_set_name(struct fsw_volume *vol, struct fsw_dnode *dno, struct fsw_string *name)
 {
-    fsw_u32 i;
-
-    // TODO: allow the host driver to do its own caching; just call through if
-    //  the appropriate function pointers are set
+    fsw_status_t    status;
 
-    // update block cache
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == phys_bno && vol->bcache[i].refcount > 0)
-            vol->bcache[i].refcount--;
+    status = fsw_arena_strdup(vol, &dno->name, vol->host_table->native_string_type, name);
+    if (status == FSW_SUCCESS) {
+        if (dno->name.data != NULL)
+            dno->flags |= FSW_DNODE_FLAG_NAME_ARENA;
+        return FSW_SUCCESS;
     }
+    if (status != FSW_UNSUPPORTED)
+        return status;
+    return fsw_strdup_coerce(&dno->name, vol->host_table->native_string_type, name);
 }
 
 /**
- * Release the block cache. Called internally when changing block sizes and when
- * unmounting the volume. It frees all data occupied by the generic block cache.
+ * Give the memory of a dnode structure and its name back to the volume's arena.
  */
 
-static void fsw_blockcache_free(struct fsw_volume *vol)
+static void fsw_dnode_dealloc(struct fsw_volume *vol, struct fsw_dnode *dno)
 {
-    fsw_u32 i;
-
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].data != NULL)
-            fsw_free(vol->bcache[i].data);
-    }
-    if (vol->bcache != NULL) {
-        fsw_free(vol->bcache);
-        vol->bcache = NULL;
-    }
-    vol->bcache_size = 0;
+    if (dno->flags & FSW_DNODE_FLAG_NAME_ARENA)
+        fsw_arena_strfree(vol, &dno->name);
+    else
+        fsw_strfree(&dno->name);
+    if (dno->flags & FSW_DNODE_FLAG_LINK_BODY)
+        fsw_arena_strfree(vol, &dno->link_body);
+    fsw_arena_free(vol, 0, dno);
 }
 
 /**
- * Add a new dnode to the list of known dnodes. This internal function is used when a
- * dnode is created to add it to the dnode list that is used to search for existing
- * dnodes by id.
+ * Look up an existing dnode by its id, taking it back from the dnode pool if it is
+ * unreferenced. Returns the retained dnode, or NULL if there is none.
  */
 
-static void fsw_dnode_register(struct fsw_volume *vol, struct fsw_dnode *dno)
+static struct fsw_dnode *fsw_dnode_find(struct fsw_volume *vol, fsw_u64 tree_id, fsw_u64 dnode_id)
 {
-    dno->next = vol->dnode_head;
-    if (vol->dnode_head != NULL)
-        vol->dnode_head->prev = dno;
-    dno->prev = NULL;
-    vol->dnode_head = dno;
+    struct fsw_dnode *dno;
+
+    if (vol->dnode_hash == NULL)
+        return NULL;
+    for (dno = vol->dnode_hash[fsw_dnode_hash(vol, tree_id, dnode_id)]; dno; dno = dno->next) {
+        if (dno->dnode_id == dnode_id && dno->tree_id == tree_id) {
+            if (dno->refcount == 0) {
+                fsw_dnode_pool_unlink(vol, dno);
+                vol->dnode_revived++;
+            }
+            fsw_dnode_retain(dno);
+            return dno;
+        }
+    }
+    return NULL;
 }
 
 /**
@@ -344,7 +1073,7 @@ fsw_status_t fsw_dnode_create_root_with_tree(struct fsw_volume *vol, fsw_u64 tre
     struct fsw_dnode *dno;
 
     // allocate memory for the structure
-    status = fsw_alloc_zero(vol->fstype_table->dnode_struct_size, (void **)&dno);
+    status = fsw_dnode_alloc(vol, &dno);
     if (status)
         return status;
 
@@ -358,7 +1087,11 @@ fsw_status_t fsw_dnode_create_root_with_tree(struct fsw_volume *vol, fsw_u64 tre
     dno->name.type = FSW_STRING_TYPE_EMPTY;
     // TODO: instead, call a function to create an empty string in the native string type
 
-    fsw_dnode_register(vol, dno);
+    status = fsw_dnode_register(vol, dno);
+    if (status) {
+        fsw_dnode_dealloc(vol, dno);
+        return status;
+    }
 
     *dno_out = dno;
     return FSW_SUCCESS;
@@ -373,7 +1106,8 @@ fsw_status_t fsw_dnode_create_root(struct fsw_volume *vol, fsw_u64 dnode_id, str
  * the file system driver in response to directory lookup or read requests. Note that
  * if there already is a dnode with the given dnode_id on record, then no new object
  * is created. Instead, the existing dnode is returned and its reference count
- * increased. All other parameters are ignored in this case.
+ * increased. All other parameters are ignored in this case. This includes dnodes
+ * that were released recently and are still kept in the volume's dnode pool.
  *
  * The type passed into this function may be FSW_DNODE_TYPE_UNKNOWN. It is sufficient
  * to fill the type field during the dnode_fill call.
@@ -394,16 +1128,14 @@ fsw_status_t fsw_dnode_create_with_tree(struct fsw_dnode *parent_dno, fsw_u64 tr
     struct fsw_dnode *dno;
 
     // check if we already have a dnode with the same id
-    for (dno = vol->dnode_head; dno; dno = dno->next) {
-        if (dno->dnode_id == dnode_id && dno->tree_id == tree_id) {
-            fsw_dnode_retain(dno);
-            *dno_out = dno;
-            return FSW_SUCCESS;
-        }
+    dno = fsw_dnode_find(vol, tree_id, dnode_id);
+    if (dno != NULL) {
+        *dno_out = dno;
+        return FSW_SUCCESS;
     }
 
     // allocate memory for the structure
-    status = fsw_alloc_zero(vol->fstype_table->dnode_struct_size, (void **)&dno);
+    status = fsw_dnode_alloc(vol, &dno);
     if (status)
         return status;
 
@@ -415,13 +1147,19 @@ fsw_status_t fsw_dnode_create_with_tree(struct fsw_dnode *parent_dno, fsw_u64 tr
     dno->dnode_id = dnode_id;
     dno->type = type;
     dno->refcount = 1;
-    status = fsw_strdup_coerce(&dno->name, vol->host_table->native_string_type, name);
+    status = fsw_dnode_set_name(vol, dno, name);
     if (status) {
-        fsw_free(dno);
+        fsw_dnode_release(dno->parent);
+        fsw_arena_free(vol, 0, dno);
         return status;
     }
 
-    fsw_dnode_register(vol, dno);
+    status = fsw_dnode_register(vol, dno);
+    if (status) {
+        fsw_dnode_release(dno->parent);
+        fsw_dnode_dealloc(vol, dno);
+        return status;
+    }
 
     *dno_out = dno;
     return FSW_SUCCESS;
@@ -445,39 +1183,97 @@ void fsw_dnode_retain(struct fsw_dnode *dno)
 }
 
 /**
- * Release a dnode pointer, deallocating it if this was the last reference.
- * This function decrements the reference counter of the dnode. If the counter
- * reaches zero, the dnode is freed. Since the parent dnode is released
- * during that process, this function may cause it to be freed, too.
+ * Remove an unreferenced dnode from the volume's dnode pool.
  */
 
-void fsw_dnode_release(struct fsw_dnode *dno)
+static void fsw_dnode_pool_unlink(struct fsw_volume *vol, struct fsw_dnode *dno)
+{
+    if (dno->pool_prev)
+        dno->pool_prev->pool_next = dno->pool_next;
+    else
+        vol->dnode_pool_head = dno->pool_next;
+    if (dno->pool_next)
+        dno->pool_next->pool_prev = dno->pool_prev;
+    else
+        vol->dnode_pool_tail = dno->pool_prev;
+    dno->pool_next = dno->pool_prev = NULL;
+    vol->dnode_pool_count--;
+}
+
+/**
+ * Deallocate an unreferenced dnode that is not in the pool. Since the parent dnode
+ * is released during that process, this function may cause it to be pooled or
+ * freed, too.
+ */
+
+static void fsw_dnode_destroy(struct fsw_dnode *dno)
 {
     struct fsw_volume *vol = dno->vol;
-    struct fsw_dnode *parent_dno;
+    struct fsw_dnode *parent_dno = dno->parent;
 
-    dno->refcount--;
+    // de-register from volume's table
+    fsw_dnode_unregister(vol, dno);
 
-    if (dno->refcount == 0) {
-        parent_dno = dno->parent;
+    // run fstype-specific cleanup
+    vol->fstype_table->dnode_free(vol, dno);
 
-        // de-register from volume's list
-        if (dno->next)
-            dno->next->prev = dno->prev;
-        if (dno->prev)
-            dno->prev->next = dno->next;
-        if (vol->dnode_head == dno)
-            vol->dnode_head = dno->next;
+    fsw_dnode_dealloc(vol, dno);
 
-        // run fstype-specific cleanup
-        vol->fstype_table->dnode_free(vol, dno);
+    // release our pointer to the parent, possibly deallocating it, too
+    if (parent_dno)
+        fsw_dnode_release(parent_dno);
+}
 
-        fsw_strfree(&dno->name);
-        fsw_free(dno);
+/**
+ * Free all dnodes kept in the volume's dnode pool. Called on unmount.
+ */
+
+static void fsw_dnode_pool_drain(struct fsw_volume *vol)
+{
+    struct fsw_dnode *dno;
+
+    while ((dno = vol->dnode_pool_tail) != NULL) {
+        fsw_dnode_pool_unlink(vol, dno);
+        fsw_dnode_destroy(dno);
+    }
+}
+
+/**
+ * Release a dnode pointer. This function decrements the reference counter of the
+ * dnode. If the counter reaches zero, the dnode is not freed right away but put
+ * into the volume's pool of unreferenced dnodes, together with its fstype-specific
+ * data, so that fsw_dnode_create can revive it when the same object is opened
+ * again. When the pool is full, the least recently released dnode is freed.
+ * Root dnodes have no parent and are freed immediately.
+ */
+
+void fsw_dnode_release(struct fsw_dnode *dno)
+{
+    struct fsw_volume *vol = dno->vol;
+    struct fsw_dnode *victim;
+
+    dno->refcount--;
+    if (dno->refcount != 0)
+        return;
+
+    if (dno->parent == NULL) {
+        fsw_dnode_destroy(dno);
+        return;
+    }
 
-        // release our pointer to the parent, possibly deallocating it, too
-        if (parent_dno)
-            fsw_dnode_release(parent_dno);
+    dno->pool_prev = NULL;
+    dno->pool_next = vol->dnode_pool_head;
+    if (vol->dnode_pool_head)
+        vol->dnode_pool_head->pool_prev = dno;
+    else
+        vol->dnode_pool_tail = dno;
+    vol->dnode_pool_head = dno;
+    vol->dnode_pool_count++;
+
+    if (vol->dnode_pool_count > FSW_DNODE_POOL_SIZE) {
+        victim = vol->dnode_pool_tail;
+        fsw_dnode_pool_unlink(vol, victim);
+        fsw_dnode_destroy(victim);
     }
 }
 
@@ -494,9 +1290,72 @@ void fsw_dnode_release(struct fsw_dnode *dno)
 
 fsw_status_t fsw_dnode_fill(struct fsw_dnode *dno)
 {
-    // TODO: check a flag right here, call fstype's dnode_fill only once per dnode
+    fsw_status_t    status;
+
+    if (dno->flags & FSW_DNODE_FLAG_FILLED)
+        return FSW_SUCCESS;
+
+    dno->vol->dnode_fills++;
+    status = dno->vol->fstype_table->dnode_fill(dno->vol, dno);
+    if (!status)
+        dno->flags |= FSW_DNODE_FLAG_FILLED;
+    return status;
+}
+
+/**
+ * Internal callbacks that capture the file system driver's dnode_stat output
+ * in the dnode's stat_* fields.
+ */
+
+static void fsw_dnode_stat_capture_time(struct fsw_dnode_stat *sb, int which, fsw_u32 posix_time)
+{
+    struct fsw_dnode *dno = (struct fsw_dnode *)sb->host_data;
 
-    return dno->vol->fstype_table->dnode_fill(dno->vol, dno);
+    if (which < FSW_DNODE_STAT_CTIME || which > FSW_DNODE_STAT_ATIME)
+        return;
+    dno->stat_time[which] = posix_time;
+    dno->flags |= FSW_DNODE_FLAG_STAT_CTIME << which;
+}
+
+static void fsw_dnode_stat_capture_attr(struct fsw_dnode_stat *sb, fsw_u16 posix_mode)
+{
+    struct fsw_dnode *dno = (struct fsw_dnode *)sb->host_data;
+
+    dno->stat_mode = posix_mode;
+    dno->flags |= FSW_DNODE_FLAG_STAT_MODE;
+}
+
+/**
+ * Ask the file system driver for a dnode's stat results and keep them in its
+ * stat_* fields, unless that has been done before.
+ */
+
+static fsw_status_t fsw_dnode_stat_load(struct fsw_dnode *dno)
+{
+    fsw_status_t    status;
+    struct fsw_dnode_stat capture;
+
+    if (dno->flags & FSW_DNODE_FLAG_STAT)
+        return FSW_SUCCESS;
+
+    status = fsw_dnode_fill(dno);
+    if (status)
+        return status;
+
+    capture.used_bytes = 0;
+    capture.store_time_posix = fsw_dnode_stat_capture_time;
+    capture.store_attr_posix = fsw_dnode_stat_capture_attr;
+    capture.host_data = dno;
+    dno->flags &= ~(FSW_DNODE_FLAG_STAT_CTIME | FSW_DNODE_FLAG_STAT_MTIME |
+                    FSW_DNODE_FLAG_STAT_ATIME | FSW_DNODE_FLAG_STAT_MODE);
+    status = dno->vol->fstype_table->dnode_stat(dno->vol, dno, &capture);
+    if (status)
+        return status;
+    if (!capture.used_bytes)
+        capture.used_bytes = FSW_U64_DIV(dno->size + dno->vol->log_blocksize - 1, dno->vol->log_blocksize);
+    dno->stat_used_bytes = capture.used_bytes;
+    dno->flags |= FSW_DNODE_FLAG_STAT;
+    return FSW_SUCCESS;
 }
 
 /**
@@ -507,20 +1366,137 @@ fsw_status_t fsw_dnode_fill(struct fsw_dnode *dno)
  * Some data requires host-specific conversion to be useful (i.e. timestamps) and
  * will be passed to callback functions instead of being written into the structure.
  * These callbacks must be filled in by the caller.
+ *
+ * The file system driver is asked only once per dnode; its results are kept in
+ * the dnode and replayed to the caller's callbacks on later calls.
  */
 
 fsw_status_t fsw_dnode_stat(struct fsw_dnode *dno, struct fsw_dnode_stat *sb)
 {
     fsw_status_t    status;
+    int             which;
 
-    status = fsw_dnode_fill(dno);
+    status = fsw_dnode_stat_load(dno);
     if (status)
         return status;
 
-    sb->used_bytes = 0;
-    status = dno->vol->fstype_table->dnode_stat(dno->vol, dno, sb);
-    if (!status && !sb->used_bytes)
-        sb->used_bytes = FSW_U64_DIV(dno->size + dno->vol->log_blocksize - 1, dno->vol->log_blocksize);
+    sb->used_bytes = dno->stat_used_bytes;
+    for (which = FSW_DNODE_STAT_CTIME; which <= FSW_DNODE_STAT_ATIME; which++) {
+        if (dno->flags & (FSW_DNODE_FLAG_STAT_CTIME << which))
+            sb->store_time_posix(sb, which, dno->stat_time[which]);
+    }
+    if (dno->flags & FSW_DNODE_FLAG_STAT_MODE)
+        sb->store_attr_posix(sb, dno->stat_mode);
+    return FSW_SUCCESS;
+}
+
+static struct fsw_lookup_entry *fsw_lookup_cache_set(struct fsw_volume *vol, struct fsw_dnode *dno, fsw_u32 name_hash)
+{
+    fsw_u32         index;
+
+    index = (name_hash ^ (fsw_u32)dno->dnode_id ^ (fsw_u32)FSW_U64_SHR(dno->dnode_id, 32) ^ (fsw_u32)dno->tree_id) * 2654435761U;
+    index = (index >> 16) & (FSW_LOOKUP_CACHE_SIZE / FSW_LOOKUP_CACHE_WAYS - 1);
+    return &vol->lookup_cache[index * FSW_LOOKUP_CACHE_WAYS];
+}
+
+/**
+ * Move entry number way of a lookup cache set to the front of the set.
+ */
+
+static void fsw_lookup_cache_promote(struct fsw_lookup_entry *set, int way)
+{
+    struct fsw_lookup_entry entry;
+
+    if (way == 0)
+        return;
+    entry = set[way];
+    for (; way > 0; way--)
+        set[way] = set[way - 1];
+    set[0] = entry;
+}
+
+static void fsw_lookup_cache_clear(struct fsw_volume *vol, struct fsw_lookup_entry *entry)
+{
+    if (entry->child != NULL)
+        fsw_dnode_release(entry->child);
+    fsw_arena_strfree(vol, &entry->name);
+    entry->child = NULL;
+    entry->name_hash = 0;
+}
+
+/**
+ * Release all entries of the lookup cache and free it. Called on unmount.
+ */
+
+static void fsw_lookup_cache_free(struct fsw_volume *vol)
+{
+    fsw_u32         i;
+
+    if (vol->lookup_cache == NULL)
+        return;
+    for (i = 0; i < FSW_LOOKUP_CACHE_SIZE; i++)
+        fsw_lookup_cache_clear(vol, &vol->lookup_cache[i]);
+    fsw_free(vol->lookup_cache);
+    vol->lookup_cache = NULL;
+}
+
+/**
+ * Look up a name in a directory through the volume's lookup cache. The cache is
+ * set-associative and remembers both found entries, holding a reference on the
+ * child dnode, and names the file system reported as not existing. Since volumes
+ * are read-only, entries stay valid until they are replaced or the volume is
+ * unmounted. The directory must already be filled.
+ */
+
+static fsw_status_t fsw_dnode_lookup_cached(struct fsw_dnode *dno,
+                                            struct fsw_string *lookup_name, struct fsw_dnode **child_dno_out)
+{
+    fsw_status_t    status;
+    struct fsw_volume *vol = dno->vol;
+    struct fsw_lookup_entry *set, *entry;
+    fsw_u32         name_hash;
+    int             way;
+
+    name_hash = fsw_strhash(lookup_name);
+    if (vol->lookup_cache == NULL) {
+        status = fsw_alloc_zero(FSW_LOOKUP_CACHE_SIZE * sizeof(struct fsw_lookup_entry),
+                                (void **)&vol->lookup_cache);
+        if (status)
+            return status;
+    }
+
+    set = fsw_lookup_cache_set(vol, dno, name_hash);
+    for (way = 0; way < FSW_LOOKUP_CACHE_WAYS; way++) {
+        entry = &set[way];
+        if (entry->name_hash == name_hash && entry->parent_dnode_id == dno->dnode_id &&
+            entry->parent_tree_id == dno->tree_id && fsw_streq(&entry->name, lookup_name)) {
+            fsw_lookup_cache_promote(set, way);
+            if (set[0].child == NULL)
+                return FSW_NOT_FOUND;
+            fsw_dnode_retain(set[0].child);
+            *child_dno_out = set[0].child;
+            return FSW_SUCCESS;
+        }
+    }
+
+    status = vol->fstype_table->dir_lookup(vol, dno, lookup_name, child_dno_out);
+    if (status != FSW_SUCCESS && status != FSW_NOT_FOUND)
+        return status;
+
+    // remember the result in place of the least recently used entry;
+    // a failure to do so only costs a later lookup
+    entry = &set[FSW_LOOKUP_CACHE_WAYS - 1];
+    fsw_lookup_cache_clear(vol, entry);
+    if (fsw_arena_strdup(vol, &entry->name, lookup_name->type, lookup_name) == FSW_SUCCESS) {
+        entry->parent_tree_id = dno->tree_id;
+        entry->parent_dnode_id = dno->dnode_id;
+        entry->name_hash = name_hash;
+        if (status == FSW_SUCCESS) {
+            entry->child = *child_dno_out;
+            fsw_dnode_retain(entry->child);
+        }
+        fsw_lookup_cache_promote(set, FSW_LOOKUP_CACHE_WAYS - 1);
+    }
     return status;
 }
 
@@ -547,7 +1523,7 @@ fsw_status_t fsw_dnode_lookup(struct fsw_dnode *dno,
     if (dno->type != FSW_DNODE_TYPE_DIR)
         return FSW_UNSUPPORTED;
 
-    return dno->vol->fstype_table->dir_lookup(dno->vol, dno, lookup_name, child_dno_out);
+    return fsw_dnode_lookup_cached(dno, lookup_name, child_dno_out);
 }
 
 /**
@@ -639,7 +1615,7 @@ fsw_status_t fsw_dnode_lookup_path(struct fsw_dnode *dno,
 
             } else {
                 // do an actual lookup
-                status = vol->fstype_table->dir_lookup(vol, dno, &lookup_name, &child_dno);
+                status = fsw_dnode_lookup_cached(dno, &lookup_name, &child_dno);
                 if (status)
                     goto errorexit;
             }
@@ -692,10 +1668,85 @@ fsw_status_t fsw_dnode_dir_read(struct fsw_shandle *shand, struct fsw_dnode **ch
     return status;
 }
 
+/**
+ * Get the next directory items in sequential order, up to max_count of them at once.
+ * This works like fsw_dnode_dir_read, but also fills and stats each entry and returns
+ * its name, type and size in a record, so a host listing a directory needs one call
+ * per batch instead of several per entry. If the file system driver provides a
+ * dir_read_batch function, the entries come from a single pass over the directory data.
+ *
+ * When the end of the directory is reached, this function returns FSW_NOT_FOUND.
+ * If the function returns FSW_SUCCESS, *count_out is at least one and the caller must
+ * call fsw_dir_records_release on the records. On errors, no records are returned and
+ * the position in the directory is unchanged.
+ */
+
+fsw_status_t fsw_dnode_dir_read_batch(struct fsw_shandle *shand, struct fsw_dir_record *records,
+                                      fsw_u32 max_count, fsw_u32 *count_out)
+{
+    fsw_status_t    status;
+    struct fsw_dnode *dno = shand->dnode;
+    fsw_u64         saved_pos;
+    fsw_u32         i, count;
+
+    if (dno->type != FSW_DNODE_TYPE_DIR || max_count == 0)
+        return FSW_UNSUPPORTED;
+
+    // collect the child dnodes
+    saved_pos = shand->pos;
+    count = 0;
+    if (dno->vol->fstype_table->dir_read_batch != NULL) {
+        status = dno->vol->fstype_table->dir_read_batch(dno->vol, dno, shand, records, max_count, &count);
+    } else {
+        do {
+            status = dno->vol->fstype_table->dir_read(dno->vol, dno, shand, &records[count].dnode);
+            if (status == FSW_SUCCESS)
+                count++;
+        } while (status == FSW_SUCCESS && count < max_count);
+        if (status == FSW_NOT_FOUND && count > 0)
+            status = FSW_SUCCESS;
+    }
+    if (status)
+        goto errorexit;
+
+    // fill in the records
+    for (i = 0; i < count; i++) {
+        status = fsw_dnode_stat_load(records[i].dnode);
+        if (status)
+            goto errorexit;
+
+        records[i].name       = records[i].dnode->name;
+        records[i].dnode_id   = records[i].dnode->dnode_id;
+        records[i].type       = records[i].dnode->type;
+        records[i].size       = records[i].dnode->size;
+    }
+
+    *count_out = count;
+    return FSW_SUCCESS;
+
+errorexit:
+    fsw_dir_records_release(records, count);
+    shand->pos = saved_pos;
+    return status;
+}
+
+/**
+ * Release the dnode references held by records from fsw_dnode_dir_read_batch.
+ */
+
+void fsw_dir_records_release(struct fsw_dir_record *records, fsw_u32 count)
+{
+    fsw_u32         i;
+
+    for (i = 0; i < count; i++)
+        fsw_dnode_release(records[i].dnode);
+}
+
 /**
  * Read the target path of a symbolic link. This function is called by the host driver
  * to read the "content" of a symbolic link, that is the relative or absolute path
- * it points to.
+ * it points to. Short targets are kept in the dnode, so the link's data is only read
+ * once while the dnode exists.
  *
  * If the function returns FSW_SUCCESS, the string handle provided by the caller is
  * filled with a string in the host's preferred encoding. The caller is responsible
@@ -712,7 +1763,17 @@ fsw_status_t fsw_dnode_readlink(struct fsw_dnode *dno, struct fsw_string *target
     if (dno->type != FSW_DNODE_TYPE_SYMLINK)
         return FSW_UNSUPPORTED;
 
-    return dno->vol->fstype_table->readlink(dno->vol, dno, target_name);
+    if (dno->flags & FSW_DNODE_FLAG_LINK_BODY)
+        return fsw_strdup_coerce(target_name, dno->vol->host_string_type, &dno->link_body);
+
+    status = dno->vol->fstype_table->readlink(dno->vol, dno, target_name);
+    if (status)
+        return status;
+
+    // keep short targets, they fit into the arena's size classes
+    if (fsw_arena_strdup(dno->vol, &dno->link_body, dno->vol->host_string_type, target_name) == FSW_SUCCESS)
+        dno->flags |= FSW_DNODE_FLAG_LINK_BODY;
+    return FSW_SUCCESS;
 }
 
 /**
@@ -768,6 +1829,11 @@ fsw_status_t fsw_dnode_readlink_data(struct fsw_dnode *dno, struct fsw_string *l
  * volume. If the host is an operating system with its own VFS layer, it should
  * resolve symlinks on its own.
  *
+ * Each symlink dnode remembers the id of the dnode it resolved to. This is a weak
+ * reference: the target is found again through the dnode hash table, so it costs
+ * nothing while the target dnode is alive or pooled, and the path is walked again
+ * once the target has been freed. All of it goes away with the dnodes on unmount.
+ *
  * If the function returns FSW_SUCCESS, *target_dno_out points at a dnode that is
  * not a symlink. The caller is responsible for calling fsw_dnode_release on it.
  */
@@ -797,16 +1863,26 @@ fsw_status_t fsw_dnode_resolve(struct fsw_dnode *dno, struct fsw_dnode **target_
             goto errorexit;
         }
 
-        // read the link's target
-        status = fsw_dnode_readlink(dno, &target_name);
-        if (status)
-            goto errorexit;
+        // follow the link to where it led last time, if that dnode still exists
+        target_dno = NULL;
+        if (dno->flags & FSW_DNODE_FLAG_LINK_TARGET)
+            target_dno = fsw_dnode_find(dno->vol, dno->link_tree_id, dno->link_dnode_id);
+        if (target_dno == NULL) {
+            // read the link's target
+            status = fsw_dnode_readlink(dno, &target_name);
+            if (status)
+                goto errorexit;
 
-        // resolve it
-        status = fsw_dnode_lookup_path(dno->parent, &target_name, '/', &target_dno);
-        fsw_strfree(&target_name);
-        if (status)
-            goto errorexit;
+            // resolve it
+            status = fsw_dnode_lookup_path(dno->parent, &target_name, '/', &target_dno);
+            fsw_strfree(&target_name);
+            if (status)
+                goto errorexit;
+
+            dno->link_tree_id = target_dno->tree_id;
+            dno->link_dnode_id = target_dno->dnode_id;
+            dno->flags |= FSW_DNODE_FLAG_LINK_TARGET;
+        }
 
         // target_dno becomes the new dno
         fsw_dnode_release(dno);
@@ -837,10 +1913,9 @@ errorexit:
 fsw_status_t fsw_shandle_open(struct fsw_dnode *dno, struct fsw_shandle *shand)
 {
     fsw_status_t    status;
-    struct fsw_volume *vol = dno->vol;
 
     // read full dnode information into memory
-    status = vol->fstype_table->dnode_fill(vol, dno);
+    status = fsw_dnode_fill(dno);
     if (status)
         return status;
 
@@ -850,6 +1925,11 @@ fsw_status_t fsw_shandle_open(struct fsw_dnode *dno, struct fsw_shandle *shand)
     shand->dnode = dno;
     shand->pos = 0;
     shand->extent.type = FSW_EXTENT_TYPE_INVALID;
+    shand->stream_pos = 0;
+    shand->stream_window = 0;
+    shand->stream_buffer = NULL;
+    shand->stream_alloc = 0;
+    shand->stream_count = 0;
 
     return FSW_SUCCESS;
 }
@@ -865,12 +1945,91 @@ void fsw_shandle_close(struct fsw_shandle *shand)
 {
     if (shand->extent.type == FSW_EXTENT_TYPE_BUFFER)
         fsw_free(shand->extent.buffer);
+    if (shand->stream_buffer != NULL)
+        fsw_free(shand->stream_buffer);
     fsw_dnode_release(shand->dnode);
 }
 
+/**
+ * Serve file data from the shandle's readahead buffer. If the block is not in the
+ * buffer and the file is being read sequentially, the buffer is refilled with the
+ * next readahead window first, and the window is doubled for the next refill. Requests
+ * that are larger than the window are left to the caller, which reads them directly.
+ *
+ * On return, *copylen_out holds the number of bytes copied, which is zero if the
+ * data was not served from the buffer.
+ */
+
+static fsw_status_t fsw_shandle_stream_read(struct fsw_shandle *shand, fsw_u64 phys_bno, fsw_u64 pos_in_physblock,
+                                            fsw_u64 extent_left, fsw_u64 buflen, fsw_u8 *buffer,
+                                            fsw_u64 *copylen_out)
+{
+    fsw_status_t    status;
+    struct fsw_volume *vol = shand->dnode->vol;
+    fsw_u64         count, offset, copylen;
+
+    *copylen_out = 0;
+
+    if (shand->stream_count == 0 || phys_bno < shand->stream_phys_start ||
+        phys_bno >= shand->stream_phys_start + shand->stream_count) {
+        // refill the buffer, but only when reading sequentially in small pieces;
+        //  larger pieces are read directly while the window grows past them
+        if (shand->stream_window == 0)
+            return FSW_SUCCESS;
+        if (buflen >= (fsw_u64)shand->stream_window * vol->phys_blocksize) {
+            if (shand->stream_window < FSW_STREAM_MAX_BYTES / vol->phys_blocksize)
+                shand->stream_window <<= 1;
+            return FSW_SUCCESS;
+        }
+
+        count = FSW_U64_DIV(pos_in_physblock + extent_left + vol->phys_blocksize - 1, vol->phys_blocksize);
+        if (count > shand->stream_window)
+            count = shand->stream_window;
+        if (shand->stream_alloc < count) {
+            if (shand->stream_buffer != NULL)
+                fsw_free(shand->stream_buffer);
+            shand->stream_alloc = 0;
+            shand->stream_count = 0;
+            status = fsw_alloc((fsw_u32)count * vol->phys_blocksize, &shand->stream_buffer);
+            if (status)
+                return status;
+            shand->stream_alloc = (fsw_u32)count;
+        }
+        shand->stream_count = 0;
+        status = fsw_block_read_direct(vol, phys_bno, (fsw_u32)count, shand->stream_buffer);
+        if (status)
+            return status;
+        shand->stream_phys_start = phys_bno;
+        shand->stream_count = (fsw_u32)count;
+
+        // grow the window for the next refill
+        if (shand->stream_window < FSW_STREAM_MAX_BYTES / vol->phys_blocksize)
+            shand->stream_window <<= 1;
+    }
+
+    offset = (phys_bno - shand->stream_phys_start) * vol->phys_blocksize + pos_in_physblock;
+    copylen = (fsw_u64)shand->stream_count * vol->phys_blocksize - offset;
+    if (copylen > extent_left)
+        copylen = extent_left;
+    if (copylen > buflen)
+        copylen = buflen;
+    fsw_memcpy(buffer, shand->stream_buffer + offset, copylen);
+    *copylen_out = copylen;
+    return FSW_SUCCESS;
+}
+
 /**
  * Read data from a shandle (storage handle for a dnode). This function is called by the
  * host driver or internally when data is read from a file. TODO: more
+ *
+ * File data covering whole physical blocks of a contiguous extent is read straight
+ * into the caller's buffer; only partial blocks at the start and end of the request,
+ * and directory data, go through the block cache.
+ *
+ * When a file is read sequentially in pieces smaller than the readahead window, its
+ * data is read ahead into a buffer of the shandle, in windows that grow from
+ * FSW_STREAM_MIN_BYTES to FSW_STREAM_MAX_BYTES. Setting pos to anywhere but the end
+ * of the previous read resets the window.
  */
 
 fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_inout, void *buffer_in)
@@ -880,7 +2039,7 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
     struct fsw_volume *vol = dno->vol;
     fsw_u8          *buffer, *block_buffer;
     fsw_u64         buflen, copylen, pos;
-    fsw_u64         log_bno, pos_in_extent, phys_bno, pos_in_physblock;
+    fsw_u64         log_bno, pos_in_extent, extent_left, phys_bno, pos_in_physblock, phys_count;
     fsw_u32         cache_level;
 
     if (shand->pos >= dno->size) {   // already at EOF
@@ -891,12 +2050,20 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
     // initialize vars
     buffer = buffer_in;
     buflen = *buffer_size_inout;
-    pos = (fsw_u32)shand->pos;
+    pos = shand->pos;
     cache_level = (dno->type != FSW_DNODE_TYPE_FILE) ? 1 : 0;
     // restrict read to file size
     if (buflen > dno->size - pos)
         buflen = (fsw_u32)(dno->size - pos);
 
+    // detect sequential reads of file data
+    if (cache_level == 0) {
+        if (pos != shand->stream_pos)
+            shand->stream_window = 0;
+        else if (shand->stream_window == 0)
+            shand->stream_window = (FSW_STREAM_MIN_BYTES + vol->phys_blocksize - 1) / vol->phys_blocksize;
+    }
+
     while (buflen > 0) {
         // get extent for the current logical block
         log_bno = FSW_U64_DIV(pos, vol->log_blocksize);
@@ -923,18 +2090,53 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
             // convert to physical block number and offset
             phys_bno = shand->extent.phys_start + FSW_U64_DIV(pos_in_extent, vol->phys_blocksize);
             pos_in_physblock = pos_in_extent & (vol->phys_blocksize - 1);
-            copylen = vol->phys_blocksize - pos_in_physblock;
-            if (copylen > buflen)
-                copylen = buflen;
+            extent_left = (fsw_u64)shand->extent.log_count * vol->log_blocksize - pos_in_extent;
 
-            // get one physical block
-            status = fsw_block_get(vol, phys_bno, cache_level, (void **)&block_buffer);
-            if (status)
-                return status;
+            // sequential file reads are served from the readahead buffer
+            copylen = 0;
+            if (cache_level == 0) {
+                status = fsw_shandle_stream_read(shand, phys_bno, pos_in_physblock, extent_left,
+                                                 buflen, buffer, &copylen);
+                if (status)
+                    return status;
+            }
+
+            // number of whole physical blocks that can go straight into the caller's buffer
+            phys_count = 0;
+            if (copylen == 0 && cache_level == 0 && pos_in_physblock == 0) {
+                phys_count = FSW_U64_DIV(extent_left, vol->phys_blocksize);
+                if (phys_count > FSW_U64_DIV(buflen, vol->phys_blocksize))
+                    phys_count = FSW_U64_DIV(buflen, vol->phys_blocksize);
+            }
 
-            // copy data from it
-            fsw_memcpy(buffer, block_buffer + pos_in_physblock, copylen);
-            fsw_block_release(vol, phys_bno, block_buffer);
+            if (copylen > 0) {
+                // served from the readahead buffer
+            } else if (phys_count > 0) {
+                // read whole blocks without the block cache
+                status = fsw_block_read_direct(vol, phys_bno, (fsw_u32)phys_count, buffer);
+                if (status)
+                    return status;
+                copylen = phys_count * vol->phys_blocksize;
+
+            } else {
+                copylen = vol->phys_blocksize - pos_in_physblock;
+                if (copylen > buflen)
+                    copylen = buflen;
+
+                // directory data: bring in the rest of the extent with one read
+                if (cache_level > 0)
+                    fsw_block_readahead(vol, phys_bno, (fsw_u32)FSW_U64_DIV(extent_left, vol->phys_blocksize),
+                                        cache_level);
+
+                // get one physical block
+                status = fsw_block_get(vol, phys_bno, cache_level, (void **)&block_buffer);
+                if (status)
+                    return status;
+
+                // copy data from it
+                fsw_memcpy(buffer, block_buffer + pos_in_physblock, copylen);
+                fsw_block_release(vol, phys_bno, block_buffer);
+            }
 
         } else if (shand->extent.type == FSW_EXTENT_TYPE_BUFFER) {
             copylen = shand->extent.log_count * vol->log_blocksize - pos_in_extent;
@@ -957,6 +2159,7 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
 
     *buffer_size_inout = (fsw_u32)(pos - shand->pos);
     shand->pos = pos;
+    shand->stream_pos = pos;
 
     return FSW_SUCCESS;
 }
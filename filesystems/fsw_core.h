@@ -55,6 +55,26 @@
 
 /** Indicates that the block cache entry is empty. */
 #define FSW_INVALID_BNO 0xFFFFFFFFFFFFFFFF
+/** Terminates a block cache hash chain or free list. */
+#define FSW_BCACHE_NIL 0xFFFFFFFF
+/** Highest cache level that can be passed to fsw_block_get. */
+#define FSW_MAX_CACHE_LEVEL (5)
+/** Largest run of blocks read into the block cache by fsw_block_readahead, in bytes. */
+#define FSW_READAHEAD_MAX_BYTES (65536)
+/** First readahead window for sequential file reads through a shandle, in bytes. */
+#define FSW_STREAM_MIN_BYTES (16384)
+/** Largest readahead window for sequential file reads through a shandle, in bytes. */
+#define FSW_STREAM_MAX_BYTES (262144)
+/** Number of entries in the per-volume path component lookup cache (power of 2). */
+#define FSW_LOOKUP_CACHE_SIZE (256)
+/** Number of entries per set in the lookup cache, kept in most recently used order. */
+#define FSW_LOOKUP_CACHE_WAYS (4)
+/** Number of unreferenced dnodes kept per volume so they can be revived without re-reading them. */
+#define FSW_DNODE_POOL_SIZE (64)
+/** Size of the memory chunks a volume's arena carves dnodes and names from, in bytes. */
+#define FSW_ARENA_CHUNK_SIZE (4096)
+/** Number of arena size classes: one for dnode structures, the rest for names of 16 to 256 bytes. */
+#define FSW_ARENA_CLASSES (6)
 
 
 //
@@ -198,6 +218,20 @@ enum {
 #define FSW_STRING_TYPE_UTF16_BE FSW_STRING_TYPE_UTF16
 #endif
 
+/**
+ * Core: A string prepared for comparison against many strings of one encoding,
+ * e.g. a name looked up in a directory. It keeps a copy of the string in that
+ * encoding, so matching candidates are compared with a plain memory compare,
+ * and a hash of its characters.
+ */
+
+struct fsw_string_key {
+    struct fsw_string str;          //!< The string, in the target encoding if it could be converted
+    fsw_u32     hash;               //!< Encoding-independent hash of the characters, see fsw_strhash
+    int         owned;              //!< Set if str.data was allocated for the key
+    int         nomatch;            //!< Set if the string cannot be represented in the target encoding
+};
+
 /** Static initializer for an empty string. */
 #define FSW_STRING_INIT { FSW_STRING_TYPE_EMPTY, 0, 0, NULL }
 
@@ -211,8 +245,39 @@ struct fsw_fstype_table;
 struct fsw_blockcache {
     fsw_u32     refcount;           //!< Reference count
     fsw_u32     cache_level;        //!< Level of importance of this block
+    fsw_u32     recent;             //!< Set when the block is hit, cleared by the eviction clock hand
     fsw_u64     phys_bno;           //!< Physical block number
     void        *data;              //!< Block data buffer
+    fsw_u32     hash_next;          //!< Next entry in the same hash chain, or in the free list
+};
+
+struct fsw_lookup_entry {
+    fsw_u64     parent_tree_id;     //!< Tree id of the directory that was searched
+    fsw_u64     parent_dnode_id;    //!< Dnode id of the directory that was searched
+    fsw_u32     name_hash;          //!< Hash of name, 0 if the entry is unused
+    struct fsw_string name;         //!< Name that was looked up
+    struct fsw_dnode *child;        //!< Referenced result of the lookup, NULL if the name does not exist
+};
+
+struct fsw_arena_chunk {
+    struct fsw_arena_chunk *next;   //!< Next chunk of the same volume
+    fsw_u64     align;              //!< Keeps the objects following the header aligned
+};
+
+/**
+ * Core: Per-volume counters for the block cache and host disk access.
+ */
+
+struct fsw_volume_stats {
+    fsw_u32     cache_hits[FSW_MAX_CACHE_LEVEL+1];      //!< fsw_block_get calls served from the block cache, per cache level
+    fsw_u32     cache_misses[FSW_MAX_CACHE_LEVEL+1];    //!< fsw_block_get calls that had to read the block, per cache level
+    fsw_u32     host_block_gets;    //!< fsw_block_get calls served by the host's block_get function
+    fsw_u32     cache_evictions;    //!< Cached blocks discarded to make room for another block
+    fsw_u32     cache_grows;        //!< Times the block cache array was enlarged
+    fsw_u32     readahead_blocks;   //!< Blocks put into the cache by fsw_block_readahead
+    fsw_u32     host_read_calls;    //!< Calls to the host's read_block and read_blocks functions
+    fsw_u64     host_read_bytes;    //!< Bytes requested from the host
+    fsw_u64     host_read_time;     //!< Nanoseconds spent in host reads, 0 if the host has no clock
 };
 
 /**
@@ -226,10 +291,36 @@ struct fsw_volume {
     struct DNODESTRUCTNAME *root;   //!< Root directory dnode
     struct fsw_string label;        //!< Volume label
 
-    struct fsw_dnode *dnode_head;   //!< List of all dnodes allocated for this volume
+    struct fsw_dnode **dnode_hash;  //!< Hash table of all dnodes allocated for this volume
+    fsw_u32     dnode_hash_mask;    //!< Number of hash buckets minus one
+    fsw_u32     dnode_count;        //!< Number of dnodes in the hash table
+
+    struct fsw_dnode *dnode_pool_head;  //!< Most recently released unreferenced dnode
+    struct fsw_dnode *dnode_pool_tail;  //!< Least recently released unreferenced dnode
+    fsw_u32     dnode_pool_count;   //!< Number of unreferenced dnodes kept in the pool
+    fsw_u32     dnode_revived;      //!< Statistics: dnodes taken back from the pool instead of being created
+    fsw_u32     dnode_fills;        //!< Statistics: calls to the fstype's dnode_fill
+
+    struct fsw_lookup_entry *lookup_cache;  //!< Cache of directory lookups by name, allocated on first use
+
+    struct fsw_arena_chunk *arena_chunks;   //!< Memory chunks for dnodes and names, freed together on unmount
+    void        *arena_free[FSW_ARENA_CLASSES];  //!< Free lists of arena objects per size class
+    fsw_u32     arena_allocs;       //!< Statistics: objects handed out by the arena
+    fsw_u32     arena_chunk_count;  //!< Statistics: chunks allocated from the host for the arena
 
     struct fsw_blockcache *bcache;  //!< Array of block cache entries
     fsw_u32     bcache_size;        //!< Number of entries in the block cache array
+    fsw_u32     *bcache_hash;       //!< Hash table of block cache entry chains, keyed by phys_bno
+    fsw_u32     bcache_hash_mask;   //!< Number of hash buckets minus one (power of 2)
+    fsw_u32     bcache_free;        //!< First unused block cache entry
+    fsw_u32     bcache_hand;        //!< Eviction clock hand (index into the block cache array)
+    fsw_u32     bcache_level_count[FSW_MAX_CACHE_LEVEL+1];  //!< Number of cached blocks per cache level
+    fsw_u32     bcache_quota[FSW_MAX_CACHE_LEVEL+1];        //!< Share of the cache reserved per cache level, in percent
+    fsw_u32     bcache_budget;      //!< Maximum number of bytes used by the block cache, 0 for no limit
+    fsw_u32     bcache_bytes;       //!< Number of bytes currently used by the block cache
+    fsw_u32     bcache_peak_bytes;  //!< High-water mark of bcache_bytes
+
+    struct fsw_volume_stats stats;  //!< Statistics: cache and disk access counters
 
     void        *host_data;         //!< Hook for a host-specific data structure
     struct fsw_host_table *host_table;      //!< Dispatch table for host-specific functions
@@ -253,10 +344,35 @@ struct fsw_dnode {
     int         type;               //!< Type of the dnode - file, dir, symlink, special
     fsw_u64     size;               //!< Data size in bytes
 
-    struct fsw_dnode *next;         //!< Doubly-linked list of all dnodes: previous dnode
-    struct fsw_dnode *prev;         //!< Doubly-linked list of all dnodes: next dnode
+    fsw_u32     flags;              //!< Core state flags, see FSW_DNODE_FLAG_*
+    fsw_u64     stat_used_bytes;    //!< Cached fsw_dnode_stat result: bytes used on disk
+    fsw_u32     stat_time[3];       //!< Cached fsw_dnode_stat result: timestamps, indexed by FSW_DNODE_STAT_*
+    fsw_u16     stat_mode;          //!< Cached fsw_dnode_stat result: Posix-style file mode
+
+    struct fsw_string link_body;    //!< Cached target path of a symlink, in the host's string type
+    fsw_u64     link_tree_id;       //!< Tree id of the dnode a symlink last resolved to
+    fsw_u64     link_dnode_id;      //!< Dnode id of the dnode a symlink last resolved to
+
+    struct fsw_dnode *next;         //!< Doubly-linked hash chain of dnodes: next dnode
+    struct fsw_dnode *prev;         //!< Doubly-linked hash chain of dnodes: previous dnode
+    struct fsw_dnode *pool_next;    //!< Pool of unreferenced dnodes: next older dnode
+    struct fsw_dnode *pool_prev;    //!< Pool of unreferenced dnodes: next younger dnode
 };
 
+/**
+ * Core state flags of a dnode. The STAT_* bits record which of the cached
+ * fsw_dnode_stat values the file system driver actually stored.
+ */
+#define FSW_DNODE_FLAG_FILLED      (0x0001)   //!< fstype's dnode_fill has succeeded
+#define FSW_DNODE_FLAG_STAT        (0x0002)   //!< The stat_* fields hold the fstype's dnode_stat result
+#define FSW_DNODE_FLAG_STAT_CTIME  (0x0010)   //!< stat_time[FSW_DNODE_STAT_CTIME] is valid
+#define FSW_DNODE_FLAG_STAT_MTIME  (0x0020)   //!< stat_time[FSW_DNODE_STAT_MTIME] is valid
+#define FSW_DNODE_FLAG_STAT_ATIME  (0x0040)   //!< stat_time[FSW_DNODE_STAT_ATIME] is valid
+#define FSW_DNODE_FLAG_STAT_MODE   (0x0080)   //!< stat_mode is valid
+#define FSW_DNODE_FLAG_NAME_ARENA  (0x0100)   //!< name.data was allocated from the volume's arena
+#define FSW_DNODE_FLAG_LINK_BODY   (0x0200)   //!< link_body holds the symlink's target path, allocated from the arena
+#define FSW_DNODE_FLAG_LINK_TARGET (0x0400)   //!< link_tree_id and link_dnode_id are valid
+
 /**
  * Possible dnode types. FSW_DNODE_TYPE_UNKNOWN may only be used before
  * fsw_dnode_fill has been called on the dnode.
@@ -302,6 +418,13 @@ struct fsw_shandle {
 
     fsw_u64     pos;                //!< Current file pointer in bytes
     struct fsw_extent extent;       //!< Current extent
+
+    fsw_u64     stream_pos;         //!< File pointer after the last read, to detect sequential reads
+    fsw_u32     stream_window;      //!< Current readahead window in blocks, 0 if reads are not sequential
+    fsw_u8      *stream_buffer;     //!< Readahead buffer for sequential file reads
+    fsw_u32     stream_alloc;       //!< Size of stream_buffer in blocks
+    fsw_u64     stream_phys_start;  //!< First physical block held in stream_buffer
+    fsw_u32     stream_count;       //!< Number of blocks held in stream_buffer
 };
 
 /**
@@ -333,8 +456,35 @@ enum {
     FSW_DNODE_STAT_ATIME
 };
 
+/**
+ * Core: One directory entry returned by fsw_dnode_dir_read_batch, with the
+ * information a host needs to list it. The record holds a reference to the
+ * entry's dnode, and name points into that dnode; fsw_dir_records_release
+ * drops the references. The dnode's stat results are cached by then, so
+ * fsw_dnode_stat on it does not call the file system driver again.
+ */
+
+struct fsw_dir_record {
+    struct fsw_dnode *dnode;        //!< Referenced dnode of the entry
+    struct fsw_string name;         //!< Name of the entry in the host's string type, owned by dnode
+    fsw_u64     dnode_id;           //!< Unique id of the entry within its tree
+    int         type;               //!< Type of the entry, one of the FSW_DNODE_TYPE_* values
+    fsw_u64     size;               //!< Data size in bytes
+};
+
 /**
  * Core: Function table for a host environment.
+ *
+ * The read_blocks function is optional. If present, the core uses it to read runs of
+ * consecutive blocks with a single call instead of calling read_block for each block.
+ *
+ * The block_get and block_release functions are optional. If present, fsw_block_get
+ * and fsw_block_release call them first and only use the core block cache when they
+ * return FSW_UNSUPPORTED. A host can use them to hand out blocks from its own cache
+ * without copying them into the core cache, or to bypass the core cache entirely.
+ *
+ * The clock function is optional. If present, it returns a monotonic time in
+ * nanoseconds and the core uses it to measure the time spent in host reads.
  */
 
 struct fsw_host_table
@@ -345,10 +495,29 @@ struct fsw_host_table
                                      fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
                                      fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize);
     fsw_status_t (*read_block)(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
+    fsw_status_t (*read_blocks)(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer);
+    fsw_status_t (*block_get)(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out);
+    fsw_status_t (*block_release)(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
+
+    fsw_u32     bcache_volume_budget;   //!< Default block cache budget per volume in bytes, 0 for no limit
+    fsw_u32     bcache_global_budget;   //!< Block cache budget for all volumes together in bytes, 0 for no limit
+
+    fsw_u64      (*clock)(void);
 };
 
 /**
  * Core: Function table for a file system driver.
+ *
+ * The dir_read_batch function is optional. If present, it returns up to max_count
+ * directory entries from one pass over the directory data, setting only the dnode
+ * member of each record; the core fills in the rest. It returns FSW_NOT_FOUND at the
+ * end of the directory. Without it, the core calls dir_read once per entry.
+ *
+ * The volume_probe function is optional as well. Hosts call it before mounting with
+ * the first probe_size bytes of the volume (fewer if the volume is smaller). It
+ * returns FSW_UNSUPPORTED if the signature the driver looks for is not there, so
+ * the host can turn a volume down without setting up a mount. Without it, the host
+ * has to try the mount.
  */
 
 struct fsw_fstype_table
@@ -374,6 +543,12 @@ struct fsw_fstype_table
                              struct fsw_shandle *shand, struct DNODESTRUCTNAME **child_dno);
     fsw_status_t (*readlink)(struct VOLSTRUCTNAME *vol, struct DNODESTRUCTNAME *dno,
                              struct fsw_string *link_target);
+    fsw_status_t (*dir_read_batch)(struct VOLSTRUCTNAME *vol, struct DNODESTRUCTNAME *dno,
+                                   struct fsw_shandle *shand, struct fsw_dir_record *records,
+                                   fsw_u32 max_count, fsw_u32 *count_out);
+
+    fsw_u32     probe_size;         //!< Bytes from the start of the volume that volume_probe looks at
+    fsw_status_t (*volume_probe)(void *head, fsw_u32 head_size);
 };
 
 
@@ -392,6 +567,8 @@ fsw_status_t fsw_volume_stat(struct fsw_volume *vol, struct fsw_volume_stat *sb)
 void         fsw_set_blocksize(struct VOLSTRUCTNAME *vol, fsw_u32 phys_blocksize, fsw_u32 log_blocksize);
 fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out);
 void         fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, void *buffer);
+void         fsw_block_readahead(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, fsw_u32 count, fsw_u32 cache_level);
+void         fsw_blockcache_global_usage(fsw_u32 *bytes_out, fsw_u32 *peak_bytes_out);
 
 /*@}*/
 
@@ -419,6 +596,9 @@ fsw_status_t fsw_dnode_lookup_path(struct fsw_dnode *dno,
                                    struct fsw_string *lookup_path, char separator,
                                    struct fsw_dnode **child_dno_out);
 fsw_status_t fsw_dnode_dir_read(struct fsw_shandle *shand, struct fsw_dnode **child_dno_out);
+fsw_status_t fsw_dnode_dir_read_batch(struct fsw_shandle *shand, struct fsw_dir_record *records,
+                                      fsw_u32 max_count, fsw_u32 *count_out);
+void         fsw_dir_records_release(struct fsw_dir_record *records, fsw_u32 count);
 fsw_status_t fsw_dnode_readlink(struct fsw_dnode *dno, struct fsw_string *link_target);
 fsw_status_t fsw_dnode_readlink_data(struct DNODESTRUCTNAME *dno, struct fsw_string *link_target);
 fsw_status_t fsw_dnode_resolve(struct fsw_dnode *dno, struct fsw_dnode **target_dno_out);
@@ -459,9 +639,14 @@ int          fsw_streq(struct fsw_string *s1, struct fsw_string *s2);
 int          fsw_streq_cstr(struct fsw_string *s1, const char *s2);
 fsw_status_t fsw_strdup_coerce(struct fsw_string *dest, int type, struct fsw_string *src);
 void         fsw_strsplit(struct fsw_string *lookup_name, struct fsw_string *buffer, char separator);
+fsw_u32      fsw_strhash(struct fsw_string *s);
 
 void         fsw_strfree(struct fsw_string *s);
 
+fsw_status_t fsw_strkey_init(struct fsw_string_key *key, int type, struct fsw_string *src);
+int          fsw_strkey_eq(struct fsw_string_key *key, struct fsw_string *s);
+void         fsw_strkey_free(struct fsw_string_key *key);
+
 /*@}*/
 
 
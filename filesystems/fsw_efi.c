@@ -68,6 +68,7 @@
 EFI_GUID gEfiDriverBindingProtocolGuid = EFI_DRIVER_BINDING_PROTOCOL_GUID;
 EFI_GUID gEfiComponentNameProtocolGuid = EFI_COMPONENT_NAME_PROTOCOL_GUID;
 extern EFI_GUID gEfiDiskIoProtocolGuid = EFI_DISK_IO_PROTOCOL_GUID;
+EFI_GUID gEfiDiskIo2ProtocolGuid = EFI_DISK_IO2_PROTOCOL_GUID;
 extern EFI_GUID gEfiBlockIoProtocolGuid = EFI_BLOCK_IO_PROTOCOL_GUID;
 EFI_GUID gEfiFileInfoGuid = EFI_FILE_INFO_ID;
 EFI_GUID gEfiFileSystemInfoGuid = EFI_FILE_SYSTEM_INFO_ID;
@@ -75,6 +76,8 @@ EFI_GUID gEfiFileSystemVolumeLabelInfoIdGuid = EFI_FILE_SYSTEM_VOLUME_LABEL_INFO
 #define gEfiSimpleFileSystemProtocolGuid FileSystemProtocol
 #endif
 
+EFI_GUID gFswStatsProtocolGuid = FSW_STATS_PROTOCOL_GUID;
+
 /** Helper macro for stringification. */
 #define FSW_EFI_STRINGIFY(x) #x
 /** Expands to the EFI driver name given the file system type name. */
@@ -106,11 +109,16 @@ void fsw_efi_change_blocksize(struct fsw_volume *vol,
                               fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
                               fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize);
 fsw_status_t fsw_efi_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
+fsw_status_t fsw_efi_read_blocks(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer);
+fsw_status_t fsw_efi_block_get(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out);
+fsw_status_t fsw_efi_block_release(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
 
 EFI_STATUS fsw_efi_map_status(fsw_status_t fsw_status, FSW_VOLUME_DATA *Volume);
 
 EFI_STATUS EFIAPI fsw_efi_FileSystem_OpenVolume(IN EFI_FILE_IO_INTERFACE *This,
                                                 OUT EFI_FILE **Root);
+EFI_STATUS EFIAPI fsw_efi_Stats_GetStats(IN FSW_STATS_PROTOCOL *This,
+                                         OUT struct fsw_volume_stats *Stats);
 EFI_STATUS fsw_efi_dnode_to_FileHandle(IN struct fsw_dnode *dno,
                                        OUT EFI_FILE **NewFileHandle);
 
@@ -132,6 +140,7 @@ EFI_STATUS fsw_efi_dir_read(IN FSW_FILE_DATA *File,
                             OUT VOID *Buffer);
 EFI_STATUS fsw_efi_dir_setpos(IN FSW_FILE_DATA *File,
                               IN UINT64 Position);
+VOID fsw_efi_dir_flush(IN FSW_FILE_DATA *File);
 
 EFI_STATUS fsw_efi_dnode_getinfo(IN FSW_FILE_DATA *File,
                                  IN EFI_GUID *InformationType,
@@ -142,21 +151,58 @@ EFI_STATUS fsw_efi_dnode_fill_FileInfo(IN FSW_VOLUME_DATA *Volume,
                                        IN OUT UINTN *BufferSize,
                                        OUT VOID *Buffer);
 
+#ifdef EFI_FILE_PROTOCOL_REVISION2
 /**
- * Structure for holding disk cache data.
+ * ReadEx requests are carried out from a timer event at TPL_CALLBACK. Calls into
+ * the driver that use the FSW core run at that TPL as well, so the event cannot
+ * interrupt them.
  */
+#define FSW_EFI_LOCK(OldTpl)    (OldTpl) = refit_call1_wrapper(BS->RaiseTPL, TPL_CALLBACK)
+#define FSW_EFI_UNLOCK(OldTpl)  refit_call1_wrapper(BS->RestoreTPL, (OldTpl))
+
+VOID fsw_efi_read_drain(IN FSW_FILE_DATA *File);
+VOID fsw_efi_read_abort(IN FSW_VOLUME_DATA *Volume);
+#else
+#define FSW_EFI_LOCK(OldTpl)    (OldTpl) = 0
+#define FSW_EFI_UNLOCK(OldTpl)
+#define fsw_efi_read_drain(File)
+#define fsw_efi_read_abort(Volume)
+#endif
 
-#define CACHE_SIZE 131072 /* 128KiB */
-struct cache_data {
-   fsw_u8            *Cache;
-   fsw_u64           CacheStart;
-   BOOLEAN           CacheValid;
-   FSW_VOLUME_DATA   *Volume; // NOTE: Do not deallocate; copied here to ID volume
-};
+/**
+ * Read cache geometry for new volumes: total size per volume and windows per set.
+ * The read-around size adapts to the access pattern between ReadAroundMin and
+ * ReadAroundMax, starting at READAROUND_INIT; a window holds ReadAroundMax bytes.
+ * All of these can be changed through the load options.
+ */
+
+#define READAROUND_INIT (128 * 1024)
+
+/**
+ * Longest wait for a prefetch to complete, and the polling interval, in microseconds.
+ */
+
+#define PREFETCH_TIMEOUT (500 * 1000)
+#define PREFETCH_POLL    (100)
+
+static UINTN ReadCacheSize = 1024 * 1024;
+static UINTN ReadCacheWays = 2;
+static UINTN ReadAroundMin = 16 * 1024;
+static UINTN ReadAroundMax = 512 * 1024;
 
-#define NUM_CACHES 2 /* Don't increase without modifying fsw_efi_read_block() */
-static struct cache_data    Caches[NUM_CACHES];
-static int LastRead = -1;
+/**
+ * Whether to prefetch through the Disk I/O 2 protocol where the firmware has it.
+ */
+
+static BOOLEAN UseDiskIo2 = TRUE;
+
+/**
+ * Load options the driver image was started with, e.g. from a Driver#### variable.
+ * Not necessarily NUL-terminated; the length is in bytes.
+ */
+
+static CHAR16   *DriverOptions = NULL;
+static UINTN    DriverOptionsSize = 0;
 
 /**
  * Interface structure for the EFI Driver Binding protocol.
@@ -189,28 +235,254 @@ struct fsw_host_table   fsw_efi_host_table = {
     FSW_STRING_TYPE_UTF16,
 
     fsw_efi_change_blocksize,
-    fsw_efi_read_block
+    fsw_efi_read_block,
+    fsw_efi_read_blocks,
+    fsw_efi_block_get,
+    fsw_efi_block_release,
+
+    0,  // no block cache budget unless set through the load options
+    0
 };
 
+#ifdef FSW_EFI_MULTI
+
+extern struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(ext2);
+extern struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(ext4);
+extern struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(reiserfs);
+extern struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(iso9660);
+extern struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(hfs);
+extern struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(btrfs);
+
+/**
+ * File system types of the multi-filesystem driver, in the order they are tried.
+ * ext2 refuses volumes with ext4 features, so it goes first and leaves those
+ * to ext4.
+ */
+
+static struct fsw_fstype_table   *fsw_efi_fstypes[] = {
+    &FSW_FSTYPE_TABLE_NAME(ext2),
+    &FSW_FSTYPE_TABLE_NAME(ext4),
+    &FSW_FSTYPE_TABLE_NAME(reiserfs),
+    &FSW_FSTYPE_TABLE_NAME(iso9660),
+    &FSW_FSTYPE_TABLE_NAME(hfs),
+    &FSW_FSTYPE_TABLE_NAME(btrfs),
+    NULL
+};
+
+#else
+
 extern struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(FSTYPE);
 
+/**
+ * File system types of the driver, in the order they are tried.
+ */
+
+static struct fsw_fstype_table   *fsw_efi_fstypes[] = {
+    &FSW_FSTYPE_TABLE_NAME(FSTYPE),
+    NULL
+};
+
+#endif
+
+
+/**
+ * Finish the volume's prefetch, if one is in flight. Unless Wait is set, this only
+ * happens if the read has already completed. Data that was read successfully joins
+ * the window's valid range.
+ *
+ * Waiting is bounded by PREFETCH_TIMEOUT, as a Disk I/O 2 stack that completes its
+ * requests at TPL_CALLBACK or below cannot make progress while we hold the lock. A
+ * read that is still outstanding after that is cancelled, and the volume starts no
+ * further prefetches. If even cancelling does not complete it, the prefetch is
+ * abandoned; the disk may still write into its window and token later, so the
+ * window stays pinned and the token is never reused or freed.
+ */
+
+static VOID fsw_efi_prefetch_complete(IN FSW_VOLUME_DATA *Volume, IN BOOLEAN Wait) {
+   struct cache_data *Entry = Volume->PrefetchEntry;
+   EFI_STATUS        Status;
+   UINTN             Waited;
+
+   if (Entry == NULL)
+      return;
+   Status = refit_call1_wrapper(BS->CheckEvent, Volume->PrefetchToken->Event);
+   if (Status == EFI_NOT_READY) {
+      if (!Wait)
+         return;
+      Volume->PrefetchWaits++;
+      for (Waited = 0; Status == EFI_NOT_READY && Waited < PREFETCH_TIMEOUT; Waited += PREFETCH_POLL) {
+         refit_call1_wrapper(BS->Stall, PREFETCH_POLL);
+         Status = refit_call1_wrapper(BS->CheckEvent, Volume->PrefetchToken->Event);
+      }
+      if (Status == EFI_NOT_READY) {
+         Volume->PrefetchTimeouts++;
+         refit_call1_wrapper(Volume->DiskIo2->Cancel, Volume->DiskIo2);
+         Status = refit_call1_wrapper(BS->CheckEvent, Volume->PrefetchToken->Event);
+      }
+      if (Status == EFI_NOT_READY) {
+         Volume->PrefetchEntry = NULL;
+         Volume->PrefetchToken = NULL;
+         return;
+      }
+   }
+
+   Volume->PrefetchEntry = NULL;
+   Entry->Pins--;
+   if (EFI_ERROR(Volume->PrefetchToken->TransactionStatus))
+      return;
+   if (Entry->ValidEnd == 0) {
+      Entry->ValidStart = Volume->PrefetchStart;
+      Entry->ValidEnd = Volume->PrefetchEnd;
+   } else if (Volume->PrefetchStart == Entry->ValidEnd) {
+      Entry->ValidEnd = Volume->PrefetchEnd;
+   }
+} // static VOID fsw_efi_prefetch_complete()
 
-static VOID EFIAPI fsw_efi_clear_cache(VOID) {
-   int i;
+/**
+ * Drop a volume's read cache, keeping windows with blocks that are still in use.
+ */
 
-   // clear the cache
-   for (i = 0; i < NUM_CACHES; i++) {
-      if (Caches[i].Cache != NULL) {
-         FreePool(Caches[i].Cache);
-         Caches[i].Cache = NULL;
+static VOID EFIAPI fsw_efi_clear_cache(IN FSW_VOLUME_DATA *Volume) {
+   UINTN i;
+
+   if (Volume->Caches == NULL)
+      return;
+   fsw_efi_prefetch_complete(Volume, TRUE);
+   for (i = 0; i < Volume->CacheSets * Volume->CacheWays; i++) {
+      if (Volume->Caches[i].Pins > 0)
+         continue;
+      if (Volume->Caches[i].Cache != NULL) {
+         FreePool(Volume->Caches[i].Cache);
+         Volume->Caches[i].Cache = NULL;
       } // if
-            Caches[i].CacheStart = 0;
-            Caches[i].CacheValid = FALSE;
-            Caches[i].Volume = NULL;
+      Volume->Caches[i].CacheStart = 0;
+      Volume->Caches[i].ValidStart = 0;
+      Volume->Caches[i].ValidEnd = 0;
    }
-   LastRead = -1;
 } // VOID EFIAPI fsw_efi_clear_cache();
 
+/**
+ * Free a volume's read cache when the volume goes away.
+ */
+
+static VOID fsw_efi_free_cache(IN FSW_VOLUME_DATA *Volume) {
+   fsw_efi_clear_cache(Volume);
+   if (Volume->Caches != NULL) {
+      FreePool(Volume->Caches);
+      Volume->Caches = NULL;
+   }
+   if (Volume->PrefetchToken != NULL) {
+      refit_call1_wrapper(BS->CloseEvent, Volume->PrefetchToken->Event);
+      FreePool(Volume->PrefetchToken);
+      Volume->PrefetchToken = NULL;
+   }
+} // static VOID fsw_efi_free_cache()
+
+/**
+ * Look up a numeric driver option of the form "name=value" in the load options.
+ * Options are separated by spaces. Returns TRUE and stores the value if the
+ * option is present with a decimal value.
+ */
+
+static BOOLEAN fsw_efi_get_option(IN CHAR16 *Name, OUT UINTN *Value)
+{
+    UINTN   Pos, Len, NameLen, Number;
+    BOOLEAN Found;
+
+    Len = DriverOptionsSize / sizeof(CHAR16);
+    for (NameLen = 0; Name[NameLen] != 0; NameLen++)
+        ;
+
+    Pos = 0;
+    while (Pos < Len && DriverOptions[Pos] != 0) {
+        // skip separators
+        if (DriverOptions[Pos] == L' ') {
+            Pos++;
+            continue;
+        }
+
+        // compare the option name
+        if (Pos + NameLen < Len && DriverOptions[Pos + NameLen] == L'=' &&
+            CompareMem(DriverOptions + Pos, Name, NameLen * sizeof(CHAR16)) == 0) {
+            Number = 0;
+            Found = FALSE;
+            for (Pos += NameLen + 1; Pos < Len && DriverOptions[Pos] >= L'0' && DriverOptions[Pos] <= L'9'; Pos++) {
+                Number = Number * 10 + (DriverOptions[Pos] - L'0');
+                Found = TRUE;
+            }
+            if (Found) {
+                *Value = Number;
+                return TRUE;
+            }
+        }
+
+        // skip to the next option
+        while (Pos < Len && DriverOptions[Pos] != 0 && DriverOptions[Pos] != L' ')
+            Pos++;
+    }
+    return FALSE;
+}
+
+/**
+ * Return the largest power of two that is not greater than n, for n > 0. The read
+ * cache masks window offsets with ReadAroundMax - 1, so the read-around sizes must
+ * be powers of two.
+ */
+
+static UINTN fsw_efi_pow2_floor(IN UINTN n)
+{
+    UINTN   Pow2;
+
+    for (Pow2 = 1; Pow2 <= n / 2; Pow2 <<= 1)
+        ;
+    return Pow2;
+}
+
+/**
+ * Fetch the load options of the driver image and apply the settings found there:
+ *
+ *  - bcache_kb=N: limit each volume's block cache to N KiB
+ *  - bcache_total_kb=N: limit the block caches of all volumes together to N KiB
+ *  - rcache_kb=N: give each volume's read cache N KiB, in windows of readaround_max_kb;
+ *    raised to one window if smaller
+ *  - rcache_ways=N: group the read cache windows into sets of N, N > 0
+ *  - readaround_min_kb=N, readaround_max_kb=N: bounds for the number of KiB read
+ *    around a block on a read cache miss; rounded down to powers of two
+ *  - prefetch=0: don't prefetch sequential reads through the Disk I/O 2 protocol
+ */
+
+static VOID fsw_efi_load_options(IN EFI_HANDLE ImageHandle)
+{
+    EFI_STATUS          Status;
+    EFI_LOADED_IMAGE    *LoadedImage;
+    UINTN               Value;
+
+    Status = refit_call3_wrapper(BS->HandleProtocol, ImageHandle, &LoadedImageProtocol, (VOID **) &LoadedImage);
+    if (EFI_ERROR(Status) || LoadedImage->LoadOptions == NULL)
+        return;
+    DriverOptions = (CHAR16 *) LoadedImage->LoadOptions;
+    DriverOptionsSize = LoadedImage->LoadOptionsSize;
+
+    if (fsw_efi_get_option(L"bcache_kb", &Value))
+        fsw_efi_host_table.bcache_volume_budget = (fsw_u32)(Value * 1024);
+    if (fsw_efi_get_option(L"bcache_total_kb", &Value))
+        fsw_efi_host_table.bcache_global_budget = (fsw_u32)(Value * 1024);
+    if (fsw_efi_get_option(L"rcache_kb", &Value))
+        ReadCacheSize = Value * 1024;
+    if (fsw_efi_get_option(L"rcache_ways", &Value) && Value > 0)
+        ReadCacheWays = Value;
+    if (fsw_efi_get_option(L"readaround_min_kb", &Value) && Value > 0)
+        ReadAroundMin = fsw_efi_pow2_floor(Value * 1024);
+    if (fsw_efi_get_option(L"readaround_max_kb", &Value) && Value > 0)
+        ReadAroundMax = fsw_efi_pow2_floor(Value * 1024);
+    if (ReadAroundMax < ReadAroundMin)
+        ReadAroundMax = ReadAroundMin;
+    if (ReadCacheSize < ReadAroundMax)   // room for at least one window
+        ReadCacheSize = ReadAroundMax;
+    if (fsw_efi_get_option(L"prefetch", &Value))
+        UseDiskIo2 = (Value != 0);
+}
+
 /**
  * Image entry point. Installs the Driver Binding and Component Name protocols
  * on the image's handle. Actually mounting a file system is initiated through
@@ -226,6 +498,8 @@ EFI_STATUS EFIAPI fsw_efi_main(IN EFI_HANDLE         ImageHandle,
     InitializeLib(ImageHandle, SystemTable);
 #endif
 
+    fsw_efi_load_options(ImageHandle);
+
     // complete Driver Binding protocol instance
     fsw_efi_DriverBinding_table.ImageHandle          = ImageHandle;
     fsw_efi_DriverBinding_table.DriverBindingHandle  = ImageHandle;
@@ -263,11 +537,61 @@ EFI_STATUS EFIAPI fsw_efi_main(IN EFI_HANDLE         ImageHandle,
 EFI_DRIVER_ENTRY_POINT(fsw_efi_main)
 #endif
 
+/**
+ * Read the start of the volume once and let each file system type look for its
+ * signature in it. Bit i of *Accepted is set if fsw_efi_fstypes[i] may be able to
+ * mount the volume: its probe found the signature, it has no probe function, or
+ * the volume could not be read. Returns EFI_UNSUPPORTED only if every type turns
+ * the volume down.
+ */
+
+static EFI_STATUS fsw_efi_probe(IN EFI_DISK_IO *DiskIo, IN EFI_BLOCK_IO *BlockIo, OUT UINTN *Accepted)
+{
+    EFI_STATUS          Status;
+    EFI_BLOCK_IO_MEDIA  *Media = BlockIo->Media;
+    UINT32              ProbeSize, HeadSize;
+    VOID                *Head;
+    UINTN               i;
+
+    *Accepted = ~(UINTN)0;
+    ProbeSize = 0;
+    for (i = 0; fsw_efi_fstypes[i] != NULL; i++) {
+        if (fsw_efi_fstypes[i]->volume_probe != NULL && ProbeSize < fsw_efi_fstypes[i]->probe_size)
+            ProbeSize = fsw_efi_fstypes[i]->probe_size;
+    }
+    if (ProbeSize == 0 || !Media->MediaPresent || Media->BlockSize == 0)
+        return EFI_SUCCESS;
+
+    // volumes smaller than the probe size get probed with what they have
+    HeadSize = ProbeSize;
+    if (Media->LastBlock < (ProbeSize - 1) / Media->BlockSize)
+        HeadSize = ((UINT32)Media->LastBlock + 1) * Media->BlockSize;
+
+    Head = AllocatePool(HeadSize);
+    if (Head == NULL)
+        return EFI_SUCCESS;
+    Status = refit_call5_wrapper(DiskIo->ReadDisk, DiskIo, Media->MediaId, 0, HeadSize, Head);
+    if (EFI_ERROR(Status)) {
+        FreePool(Head);
+        return EFI_SUCCESS;
+    }
+
+    *Accepted = 0;
+    for (i = 0; fsw_efi_fstypes[i] != NULL; i++) {
+        if (fsw_efi_fstypes[i]->volume_probe == NULL ||
+            fsw_efi_fstypes[i]->volume_probe(Head, HeadSize) == FSW_SUCCESS)
+            *Accepted |= (UINTN)1 << i;
+    }
+    FreePool(Head);
+    return (*Accepted != 0) ? EFI_SUCCESS : EFI_UNSUPPORTED;
+}
+
 /**
  * Driver Binding EFI protocol, Supported function. This function is called by EFI
- * to test if this driver can handle a certain device. Our implementation only checks
- * if the device is a disk (i.e. that it supports the Block I/O and Disk I/O protocols)
- * and implicitly checks if the disk is already in use by another driver.
+ * to test if this driver can handle a certain device. It checks that the device is
+ * a disk (i.e. that it supports the Block I/O and Disk I/O protocols), implicitly
+ * checks if the disk is already in use by another driver, and then looks for the
+ * file system signatures with one small read from the start of the disk.
  */
 
 EFI_STATUS EFIAPI fsw_efi_DriverBinding_Supported(IN EFI_DRIVER_BINDING_PROTOCOL  *This,
@@ -276,6 +600,8 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Supported(IN EFI_DRIVER_BINDING_PROTOCOL
 {
     EFI_STATUS          Status;
     EFI_DISK_IO         *DiskIo;
+    EFI_BLOCK_IO        *BlockIo;
+    UINTN               Accepted;
 
     // we check for both DiskIO and BlockIO protocols
 
@@ -289,27 +615,31 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Supported(IN EFI_DRIVER_BINDING_PROTOCOL
     if (EFI_ERROR(Status))
         return Status;
 
-    // we were just checking, close it again
-    refit_call4_wrapper(BS->CloseProtocol, ControllerHandle,
-                      &gEfiDiskIoProtocolGuid,
-                      This->DriverBindingHandle,
-                      ControllerHandle);
-
-    // next, check BlockIO without actually opening it
+    // next, check BlockIO without opening it for the driver, we need the media for the probe
     Status = refit_call6_wrapper(BS->OpenProtocol, ControllerHandle,
                               &gEfiBlockIoProtocolGuid,
-                              NULL,
+                              (VOID **) &BlockIo,
                               This->DriverBindingHandle,
                               ControllerHandle,
-                              EFI_OPEN_PROTOCOL_TEST_PROTOCOL);
+                              EFI_OPEN_PROTOCOL_GET_PROTOCOL);
+    if (!EFI_ERROR(Status))
+        Status = fsw_efi_probe(DiskIo, BlockIo, &Accepted);
+
+    // we were just checking, close DiskIO again
+    refit_call4_wrapper(BS->CloseProtocol, ControllerHandle,
+                      &gEfiDiskIoProtocolGuid,
+                      This->DriverBindingHandle,
+                      ControllerHandle);
     return Status;
 }
 
 /**
  * Driver Binding EFI protocol, Start function. This function is called by EFI
  * to start driving the given device. It is still possible at this point to
- * return EFI_UNSUPPORTED, and in fact we will do so if the file system driver
- * cannot find the superblock signature (or equivalent) that it expects.
+ * return EFI_UNSUPPORTED, and in fact we will do so if no file system driver
+ * finds the superblock signature (or equivalent) that it expects. The volume
+ * is probed again here, as Supported may have been called for another device
+ * in between, and only the types whose probe accepted it try to mount it.
  *
  * This function allocates memory for a per-volume structure, opens the
  * required protocols (just Disk I/O in our case, Block I/O is only looked
@@ -325,7 +655,11 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Start(IN EFI_DRIVER_BINDING_PROTOCOL  *T
     EFI_STATUS          Status;
     EFI_BLOCK_IO        *BlockIo;
     EFI_DISK_IO         *DiskIo;
+    EFI_DISK_IO2_PROTOCOL *DiskIo2;
     FSW_VOLUME_DATA     *Volume;
+    UINTN               Accepted;
+    EFI_STATUS          MountStatus;
+    UINTN               i;
 
 #if DEBUG_LEVEL
     Print(L"fsw_efi_DriverBinding_Start\n");
@@ -354,26 +688,74 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Start(IN EFI_DRIVER_BINDING_PROTOCOL  *T
         return Status;
     }
 
+    // Disk I/O 2 is optional, it is only used for prefetching
+    DiskIo2 = NULL;
+    if (UseDiskIo2) {
+        Status = refit_call6_wrapper(BS->OpenProtocol, ControllerHandle,
+                                  &gEfiDiskIo2ProtocolGuid,
+                                  (VOID **) &DiskIo2,
+                                  This->DriverBindingHandle,
+                                  ControllerHandle,
+                                  EFI_OPEN_PROTOCOL_BY_DRIVER);
+        if (EFI_ERROR(Status))
+            DiskIo2 = NULL;
+    }
+
     // allocate volume structure
     Volume = AllocateZeroPool(sizeof(FSW_VOLUME_DATA));
     Volume->Signature       = FSW_VOLUME_DATA_SIGNATURE;
     Volume->Handle          = ControllerHandle;
     Volume->DiskIo          = DiskIo;
+    Volume->DiskIo2         = DiskIo2;
     Volume->MediaId         = BlockIo->Media->MediaId;
     Volume->LastIOStatus    = EFI_SUCCESS;
-
-    // mount the filesystem
-    Status = fsw_efi_map_status(fsw_mount(Volume, &fsw_efi_host_table,
-                                          &FSW_FSTYPE_TABLE_NAME(FSTYPE), &Volume->vol),
-                                Volume);
+    Volume->ReadAroundMin   = ReadAroundMin;
+    Volume->ReadAroundMax   = ReadAroundMax;
+    Volume->ReadAround      = READAROUND_INIT;
+    if (Volume->ReadAround < ReadAroundMin)
+        Volume->ReadAround = ReadAroundMin;
+    if (Volume->ReadAround > ReadAroundMax)
+        Volume->ReadAround = ReadAroundMax;
+    while (((UINTN)1 << Volume->ReadAroundShift) < ReadAroundMax)
+        Volume->ReadAroundShift++;
+    Volume->CacheWays       = ReadCacheWays;
+    Volume->CacheSets       = 1;
+    if (ReadCacheSize / ReadAroundMax > ReadCacheWays)
+        Volume->CacheSets   = ReadCacheSize / ReadAroundMax / ReadCacheWays;
+    else if (ReadCacheSize / ReadAroundMax > 0)
+        Volume->CacheWays   = ReadCacheSize / ReadAroundMax;
+    else
+        Volume->CacheWays   = 1;
+
+    // mount the filesystem with the first file system type that recognizes it,
+    // skipping the types whose probe turned it down; the read cache keeps the disk
+    // from being read again for each type. A type that fails to mount does not stop
+    // the others, its error is only reported if none of them succeeds.
+    fsw_efi_probe(DiskIo, BlockIo, &Accepted);
+    Status = EFI_UNSUPPORTED;
+    for (i = 0; fsw_efi_fstypes[i] != NULL && Volume->vol == NULL; i++) {
+        if ((Accepted & ((UINTN)1 << i)) == 0)
+            continue;
+        MountStatus = fsw_efi_map_status(fsw_mount(Volume, &fsw_efi_host_table,
+                                                   fsw_efi_fstypes[i], &Volume->vol),
+                                         Volume);
+        if (Volume->vol != NULL)
+            Status = EFI_SUCCESS;
+        else if (Status == EFI_UNSUPPORTED && EFI_ERROR(MountStatus))
+            Status = MountStatus;   // the first real error, unless a later type mounts
+    }
 
     if (!EFI_ERROR(Status)) {
         // register the SimpleFileSystem protocol
         Volume->FileSystem.Revision     = EFI_FILE_IO_INTERFACE_REVISION;
         Volume->FileSystem.OpenVolume   = fsw_efi_FileSystem_OpenVolume;
-        Status = refit_call4_wrapper(BS->InstallMultipleProtocolInterfaces, &ControllerHandle,
+        Volume->Stats.Revision          = FSW_STATS_PROTOCOL_REVISION;
+        Volume->Stats.GetStats          = fsw_efi_Stats_GetStats;
+        Status = refit_call6_wrapper(BS->InstallMultipleProtocolInterfaces, &ControllerHandle,
                                                        &gEfiSimpleFileSystemProtocolGuid,
                                                        &Volume->FileSystem,
+                                                       &gFswStatsProtocolGuid,
+                                                       &Volume->Stats,
                                                        NULL);
         if (EFI_ERROR(Status)) {
 //            Print(L"Fsw ERROR: InstallMultipleProtocolInterfaces returned %x\n", Status);
@@ -384,12 +766,18 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Start(IN EFI_DRIVER_BINDING_PROTOCOL  *T
     if (EFI_ERROR(Status)) {
         if (Volume->vol != NULL)
             fsw_unmount(Volume->vol);
+        fsw_efi_free_cache(Volume);
         FreePool(Volume);
 
         refit_call4_wrapper(BS->CloseProtocol, ControllerHandle,
                           &gEfiDiskIoProtocolGuid,
                           This->DriverBindingHandle,
                           ControllerHandle);
+        if (DiskIo2 != NULL)
+            refit_call4_wrapper(BS->CloseProtocol, ControllerHandle,
+                              &gEfiDiskIo2ProtocolGuid,
+                              This->DriverBindingHandle,
+                              ControllerHandle);
     }
 
     return Status;
@@ -413,6 +801,8 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Stop(IN  EFI_DRIVER_BINDING_PROTOCOL  *T
     EFI_STATUS          Status;
     EFI_FILE_IO_INTERFACE *FileSystem;
     FSW_VOLUME_DATA     *Volume;
+    BOOLEAN             HaveDiskIo2;
+    EFI_TPL             OldTpl;
 
 #if DEBUG_LEVEL
     Print(L"fsw_efi_DriverBinding_Stop\n");
@@ -432,8 +822,9 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Stop(IN  EFI_DRIVER_BINDING_PROTOCOL  *T
     Volume = FSW_VOLUME_FROM_FILE_SYSTEM(FileSystem);
 
     // uninstall Simple File System protocol
-    Status = refit_call4_wrapper(BS->UninstallMultipleProtocolInterfaces, ControllerHandle,
+    Status = refit_call6_wrapper(BS->UninstallMultipleProtocolInterfaces, ControllerHandle,
                                                      &gEfiSimpleFileSystemProtocolGuid, &Volume->FileSystem,
+                                                     &gFswStatsProtocolGuid, &Volume->Stats,
                                                      NULL);
     if (EFI_ERROR(Status)) {
  //       Print(L"Fsw ERROR: UninstallMultipleProtocolInterfaces returned %x\n", Status);
@@ -441,22 +832,48 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Stop(IN  EFI_DRIVER_BINDING_PROTOCOL  *T
     }
 #if DEBUG_LEVEL
     Print(L"fsw_efi_DriverBinding_Stop: protocol uninstalled successfully\n");
+    if (Volume->vol != NULL) {
+        Print(L"fsw_efi_DriverBinding_Stop: block cache peak %d bytes, budget %d bytes\n",
+              Volume->vol->bcache_peak_bytes, Volume->vol->bcache_budget);
+        Print(L"fsw_efi_DriverBinding_Stop: %d host reads, %d cache evictions, %d cache grows\n",
+              Volume->vol->stats.host_read_calls, Volume->vol->stats.cache_evictions,
+              Volume->vol->stats.cache_grows);
+        Print(L"fsw_efi_DriverBinding_Stop: %d dnode fills, %d dnodes revived from the pool\n",
+              Volume->vol->dnode_fills, Volume->vol->dnode_revived);
+        Print(L"fsw_efi_DriverBinding_Stop: %d arena allocations from %d chunks\n",
+              Volume->vol->arena_allocs, Volume->vol->arena_chunk_count);
+    }
+    Print(L"fsw_efi_DriverBinding_Stop: read cache %ld hits, %ld misses reading %ld bytes, read-around %d bytes\n",
+          Volume->CacheHits, Volume->CacheMisses, Volume->CacheMissBytes, Volume->ReadAround);
+    Print(L"fsw_efi_DriverBinding_Stop: %ld prefetches, %ld waited for, %ld timed out\n",
+          Volume->Prefetches, Volume->PrefetchWaits, Volume->PrefetchTimeouts);
 #endif
 
-    // release private data structure
+    // fail the ReadEx requests that are still queued, then release private data structure
+    FSW_EFI_LOCK(OldTpl);
+    fsw_efi_read_abort(Volume);
+    FSW_EFI_UNLOCK(OldTpl);
+    HaveDiskIo2 = (Volume->DiskIo2 != NULL);
+#ifdef EFI_FILE_PROTOCOL_REVISION2
+    if (Volume->ReadEvent != NULL)
+        refit_call1_wrapper(BS->CloseEvent, Volume->ReadEvent);
+#endif
     if (Volume->vol != NULL)
         fsw_unmount(Volume->vol);
+    fsw_efi_free_cache(Volume);
     FreePool(Volume);
 
     // close the consumed protocols
+    if (HaveDiskIo2)
+        refit_call4_wrapper(BS->CloseProtocol, ControllerHandle,
+                          &gEfiDiskIo2ProtocolGuid,
+                          This->DriverBindingHandle,
+                          ControllerHandle);
     Status = refit_call4_wrapper(BS->CloseProtocol, ControllerHandle,
                                &gEfiDiskIoProtocolGuid,
                                This->DriverBindingHandle,
                                ControllerHandle);
 
-    // clear the cache
-    fsw_efi_clear_cache();
-
     return Status;
 }
 
@@ -506,75 +923,257 @@ void fsw_efi_change_blocksize(struct fsw_volume *vol,
     // nothing to do
 }
 
+/**
+ * Adapt the read-around size to a read cache miss at disk offset StartRead. Misses
+ * that pick up where the previous one left off look like a sequential load, so the
+ * read-around grows to need fewer, larger reads. Misses far away from the previous
+ * one look like metadata probes, where most of a large read-around is wasted, so it
+ * shrinks. A single miss of either kind leaves the size alone. Returns TRUE for a
+ * sequential miss.
+ */
+
+static BOOLEAN fsw_efi_adapt_readaround(IN FSW_VOLUME_DATA *Volume, IN fsw_u64 StartRead) {
+   fsw_u64          Distance;
+
+   if (Volume->CacheMisses > 0 && StartRead == Volume->LastMissEnd) {
+      Volume->ScatteredMisses = 0;
+      if (++Volume->SeqMisses >= 2 && Volume->ReadAround < Volume->ReadAroundMax) {
+         Volume->ReadAround <<= 1;
+         Volume->SeqMisses = 0;
+      }
+      return TRUE;
+   }
+
+   Volume->SeqMisses = 0;
+   Distance = (StartRead > Volume->LastMissEnd) ? StartRead - Volume->LastMissEnd
+                                                : Volume->LastMissEnd - StartRead;
+   if (Volume->CacheMisses == 0 || Distance > Volume->ReadAroundMax) {
+      if (++Volume->ScatteredMisses >= 2 && Volume->ReadAround > Volume->ReadAroundMin) {
+         Volume->ReadAround >>= 1;
+         Volume->ScatteredMisses = 0;
+      }
+   }
+   return FALSE;
+} // static BOOLEAN fsw_efi_adapt_readaround()
+
+/**
+ * Start reading the ReadAround bytes at disk offset StartRead into the read cache
+ * without waiting for them, so the disk works while the file system driver goes
+ * through the data before it. This needs the Disk I/O 2 protocol. Only one prefetch
+ * per volume is in flight; its window counts as in use until it is complete. The
+ * data goes either right after the valid part of the window that holds StartRead,
+ * or into an empty window.
+ */
+
+static VOID fsw_efi_prefetch(IN FSW_VOLUME_DATA *Volume, IN fsw_u64 StartRead) {
+   UINTN            i;
+   struct cache_data *Set, *Entry;
+   EFI_STATUS       Status;
+   fsw_u64          Window = FSW_U64_SHR(StartRead, Volume->ReadAroundShift);
+   fsw_u64          WindowStart = StartRead & ~(fsw_u64)(Volume->ReadAroundMax - 1);
+   UINTN            Offset = (UINTN)(StartRead - WindowStart);
+   UINTN            End;
+
+   Volume->PrefetchTrigger = Volume->PrefetchNext = 0;
+   if (Volume->DiskIo2 == NULL || Volume->PrefetchEntry != NULL || Volume->PrefetchTimeouts > 0)
+      return;
+
+   // Find the window, or one to replace that was not just used....
+   Set = &Volume->Caches[((UINTN)Window % Volume->CacheSets) * Volume->CacheWays];
+   Entry = NULL;
+   for (i = 0; i < Volume->CacheWays; i++) {
+      if (Set[i].ValidEnd > 0 && Set[i].CacheStart == WindowStart) {
+         Entry = &Set[i];
+         break;
+      }
+      if (Set[i].Pins == 0 && Set[i].LastUse < Volume->CacheTick &&
+          (Entry == NULL || Set[i].LastUse < Entry->LastUse))
+         Entry = &Set[i];
+   }
+   if (Entry == NULL)
+      return;
+   if (Entry->ValidEnd > 0 && Entry->CacheStart == WindowStart) {
+      if (Entry->ValidEnd != Offset)
+         return;
+   } else {
+      Entry->ValidStart = Entry->ValidEnd = 0;
+      Entry->CacheStart = WindowStart;
+      Entry->LastUse = Volume->CacheTick;
+   }
+   if (Entry->Cache == NULL)
+      Entry->Cache = AllocatePool(Volume->ReadAroundMax);
+   if (Entry->Cache == NULL)
+      return;
+   if (Volume->PrefetchToken == NULL) {
+      Volume->PrefetchToken = AllocateZeroPool(sizeof(EFI_DISK_IO2_TOKEN));
+      if (Volume->PrefetchToken == NULL)
+         return;
+      Status = refit_call5_wrapper(BS->CreateEvent, 0, 0, NULL, NULL, &Volume->PrefetchToken->Event);
+      if (EFI_ERROR(Status)) {
+         FreePool(Volume->PrefetchToken);
+         Volume->PrefetchToken = NULL;
+         return;
+      }
+   }
+
+   End = Offset + Volume->ReadAround;
+   if (End > Volume->ReadAroundMax)
+      End = Volume->ReadAroundMax;
+   Volume->PrefetchToken->TransactionStatus = EFI_NOT_READY;   // counts as failed until the disk sets it
+   Status = refit_call6_wrapper(Volume->DiskIo2->ReadDiskEx, Volume->DiskIo2, Volume->MediaId,
+                                StartRead, Volume->PrefetchToken, End - Offset, Entry->Cache + Offset);
+   if (EFI_ERROR(Status))
+      return;
+   Entry->Pins++;
+   Volume->PrefetchEntry = Entry;
+   Volume->PrefetchStart = Offset;
+   Volume->PrefetchEnd = End;
+   Volume->PrefetchTrigger = StartRead;
+   Volume->PrefetchNext = WindowStart + End;
+   Volume->LastMissEnd = Volume->PrefetchNext;
+   Volume->Prefetches++;
+} // static VOID fsw_efi_prefetch()
+
+/**
+ * Find a block in the read cache, loading the disk around it if necessary.
+ * Reading ahead helps a lot on some systems. (VirtualBox is particularly
+ * susceptible to performance problems with an uncached driver -- the ext2 driver can
+ * take 200 seconds to load a Linux kernel under VirtualBox, whereas the time is more
+ * like 3 seconds with a cache!) Each volume has its own cache, so scanning several
+ * volumes in turn does not throw out the others' windows. The cache is set-associative:
+ * a window of ReadAroundMax bytes can only go into the set picked by its disk offset,
+ * where it replaces the least recently used window. With two or more ways, the ext2fs
+ * driver's habit of alternating between two parts of the disk does not thrash. A
+ * window holding blocks handed out by fsw_efi_block_get is not reused.
+ *
+ * A miss reads only the aligned ReadAround bytes around the block into its window,
+ * next to what the window already holds if the two ranges touch. Blocks that are in
+ * use are never overwritten, as only missing parts of a window are read. Sequential
+ * misses start a prefetch of what follows, and reaching prefetched data starts the
+ * next one.
+ *
+ * Returns a pointer to the block's data within the cache and stores the window in
+ * *CacheOut, or returns NULL if the block could not be cached.
+ */
+
+static fsw_u8 * fsw_efi_cache_block(struct fsw_volume *vol, fsw_u64 phys_bno, struct cache_data **CacheOut) {
+   UINTN            i;
+   FSW_VOLUME_DATA  *Volume = (FSW_VOLUME_DATA *)vol->host_data;
+   struct cache_data *Set, *Entry;
+   EFI_STATUS       Status;
+   fsw_u64          StartRead = phys_bno * vol->phys_blocksize;
+   fsw_u64          Window = FSW_U64_SHR(StartRead, Volume->ReadAroundShift);
+   fsw_u64          WindowStart = StartRead & ~(fsw_u64)(Volume->ReadAroundMax - 1);
+   UINTN            Offset = (UINTN)(StartRead - WindowStart);
+   UINTN            ChunkSize, ChunkStart, ChunkEnd;
+   BOOLEAN          Sequential;
+
+   // blocks straddling two windows are not cached
+   if (Offset + vol->phys_blocksize > Volume->ReadAroundMax)
+      return NULL;
+
+   // Initialize the volume's cache, if necessary....
+   if (Volume->Caches == NULL) {
+      Volume->Caches = AllocateZeroPool(Volume->CacheSets * Volume->CacheWays * sizeof(struct cache_data));
+      if (Volume->Caches == NULL)
+         return NULL;
+   } // if
+   fsw_efi_prefetch_complete(Volume, FALSE);
+
+   // Look for the window in its set....
+   Volume->CacheTick++;
+   Set = &Volume->Caches[((UINTN)Window % Volume->CacheSets) * Volume->CacheWays];
+   Entry = NULL;
+   for (i = 0; i < Volume->CacheWays; i++) {
+      if ((Set[i].ValidEnd > 0 || &Set[i] == Volume->PrefetchEntry) && Set[i].CacheStart == WindowStart) {
+         Entry = &Set[i];
+         break;
+      }
+      if (Set[i].Pins == 0 && (Entry == NULL || Set[i].LastUse < Entry->LastUse))
+         Entry = &Set[i];
+   }
+   if (Entry == NULL)   // all windows in the set are in use
+      return NULL;
+   Entry->LastUse = Volume->CacheTick;
+   if (Entry == Volume->PrefetchEntry && !(Offset >= Entry->ValidStart &&
+                                          Offset + vol->phys_blocksize <= Entry->ValidEnd))
+      fsw_efi_prefetch_complete(Volume, TRUE);   // the block may be on its way
+   if (Entry->ValidEnd > 0 && Entry->CacheStart == WindowStart &&
+       Offset >= Entry->ValidStart && Offset + vol->phys_blocksize <= Entry->ValidEnd) {
+      Volume->CacheHits++;
+      if (StartRead >= Volume->PrefetchTrigger && StartRead < Volume->PrefetchNext &&
+          Volume->PrefetchEntry == NULL)
+         fsw_efi_prefetch(Volume, Volume->PrefetchNext);
+      *CacheOut = Entry;
+      return &Entry->Cache[Offset];
+   }
+
+   // Cache miss; read around the block....
+   Sequential = fsw_efi_adapt_readaround(Volume, StartRead);
+   ChunkSize = Volume->ReadAround;
+   while (ChunkSize < vol->phys_blocksize)
+      ChunkSize <<= 1;
+   ChunkStart = Offset & ~(ChunkSize - 1);
+   ChunkEnd = ChunkStart + ChunkSize;
+   if (ChunkEnd < Offset + vol->phys_blocksize || ChunkEnd > Volume->ReadAroundMax)
+      return NULL;
+   if (Entry->CacheStart != WindowStart || Entry->ValidEnd == 0) {
+      Entry->ValidStart = Entry->ValidEnd = 0;
+      Entry->CacheStart = WindowStart;
+   } else if (ChunkStart <= Entry->ValidEnd && ChunkEnd >= Entry->ValidStart) {
+      if (Offset >= Entry->ValidEnd)     // don't read what the window already holds
+         ChunkStart = Entry->ValidEnd;
+      else
+         ChunkEnd = Entry->ValidStart;
+   } else if (Entry->Pins > 0) {
+      return NULL;                       // its blocks would no longer count as read
+   }
+   if (Entry->Cache == NULL)
+      Entry->Cache = AllocatePool(Volume->ReadAroundMax);
+   if (Entry->Cache == NULL)
+      return NULL;
+   Volume->CacheMisses++;
+   Volume->CacheMissBytes += ChunkEnd - ChunkStart;
+   Volume->LastMissEnd = WindowStart + ChunkEnd;
+   Status = refit_call5_wrapper(Volume->DiskIo->ReadDisk, Volume->DiskIo, Volume->MediaId,
+                                WindowStart + ChunkStart, ChunkEnd - ChunkStart, Entry->Cache + ChunkStart);
+   if (EFI_ERROR(Status))
+      return NULL;
+   if (Entry->ValidEnd > 0 && ChunkStart <= Entry->ValidEnd && ChunkEnd >= Entry->ValidStart) {
+      if (ChunkStart < Entry->ValidStart)
+         Entry->ValidStart = ChunkStart;
+      if (ChunkEnd > Entry->ValidEnd)
+         Entry->ValidEnd = ChunkEnd;
+   } else {
+      Entry->ValidStart = ChunkStart;
+      Entry->ValidEnd = ChunkEnd;
+   }
+   if (Sequential)
+      fsw_efi_prefetch(Volume, Volume->LastMissEnd);
+
+   *CacheOut = Entry;
+   return &Entry->Cache[Offset];
+} // static fsw_u8 * fsw_efi_cache_block()
+
 /**
  * FSW interface function to read data blocks. This function is called by the FSW core
  * to read a block of data from the device. The buffer is allocated by the core code.
- * Two caches are maintained, so as to improve performance on some systems. (VirtualBox
- * is particularly susceptible to performance problems with an uncached driver -- the
- * ext2 driver can take 200 seconds to load a Linux kernel under VirtualBox, whereas
- * the time is more like 3 seconds with a cache!) Two independent caches are maintained
- * because the ext2fs driver tends to alternate between accessing two parts of the
- * disk.
+ * The block is copied from the read cache; if it cannot be cached, it is read on its own.
  */
 
 fsw_status_t fsw_efi_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer) {
-   int              i, ReadCache = -1;
+   struct cache_data *ReadCache;
+   fsw_u8           *CachedBlock;
    FSW_VOLUME_DATA  *Volume = (FSW_VOLUME_DATA *)vol->host_data;
    EFI_STATUS       Status = EFI_SUCCESS;
-   BOOLEAN          ReadOneBlock = FALSE;
-   fsw_u64          StartRead = phys_bno * vol->phys_blocksize;
 
    if (buffer == NULL)
       return (fsw_status_t) EFI_BAD_BUFFER_SIZE;
 
-   // Initialize static data structures, if necessary....
-   if (LastRead < 0) {
-      fsw_efi_clear_cache();
-   } // if
-
-   // Look for a cache hit on the current query....
-   i = 0;
-   do {
-      if ((Caches[i].Volume == Volume) &&
-	  (Caches[i].CacheValid == TRUE) &&
-          (StartRead >= Caches[i].CacheStart) &&
-          ((StartRead + vol->phys_blocksize) <= (Caches[i].CacheStart + CACHE_SIZE))) {
-         ReadCache = i;
-      }
-      i++;
-   } while ((i < NUM_CACHES) && (ReadCache < 0));
-
-   // No cache hit found; load new cache and pass it on....
-   if (ReadCache < 0) {
-      if (LastRead == -1)
-         LastRead = 1;
-      ReadCache = 1 - LastRead; // NOTE: If NUM_CACHES > 2, this must become more complex
-      Caches[ReadCache].CacheValid = FALSE;
-      if (Caches[ReadCache].Cache == NULL)
-         Caches[ReadCache].Cache = AllocatePool(CACHE_SIZE);
-      if (Caches[ReadCache].Cache != NULL) {
-         Status = refit_call5_wrapper(Volume->DiskIo->ReadDisk, Volume->DiskIo, Volume->MediaId,
-                                      StartRead, CACHE_SIZE, Caches[ReadCache].Cache);
-         if (!EFI_ERROR(Status)) {
-            Caches[ReadCache].CacheStart = StartRead;
-            Caches[ReadCache].CacheValid = TRUE;
-            Caches[ReadCache].Volume = Volume;
-            LastRead = ReadCache;
-         } else {
-            ReadOneBlock = TRUE;
-         }
-      } else {
-         ReadOneBlock = TRUE;
-      } // if cache memory allocated
-   } // if (ReadCache < 0)
-
-   if (Caches[ReadCache].Cache != NULL && Caches[ReadCache].CacheValid == TRUE) {
-      CopyMem(buffer, &Caches[ReadCache].Cache[StartRead - Caches[ReadCache].CacheStart], vol->phys_blocksize);
-   } else {
-      ReadOneBlock = TRUE;
-   }
-
-   if (ReadOneBlock) { // Something's failed, so try a simple disk read of one block....
+   CachedBlock = fsw_efi_cache_block(vol, phys_bno, &ReadCache);
+   if (CachedBlock != NULL) {
+      CopyMem(buffer, CachedBlock, vol->phys_blocksize);
+   } else { // Something's failed, so try a simple disk read of one block....
       Status = refit_call5_wrapper(Volume->DiskIo->ReadDisk, Volume->DiskIo, Volume->MediaId,
                                    phys_bno * vol->phys_blocksize,
                                    vol->phys_blocksize,
@@ -585,6 +1184,73 @@ fsw_status_t fsw_efi_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *
    return Status;
 } // fsw_status_t *fsw_efi_read_block()
 
+/**
+ * FSW interface function to read a run of consecutive blocks. This function is called
+ * by the FSW core for bulk reads; the whole run is read with a single disk access,
+ * straight into the buffer provided by the core.
+ */
+
+fsw_status_t fsw_efi_read_blocks(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer) {
+   FSW_VOLUME_DATA  *Volume = (FSW_VOLUME_DATA *)vol->host_data;
+   EFI_STATUS       Status;
+
+   if (buffer == NULL)
+      return (fsw_status_t) EFI_BAD_BUFFER_SIZE;
+
+   Status = refit_call5_wrapper(Volume->DiskIo->ReadDisk, Volume->DiskIo, Volume->MediaId,
+                                phys_bno * vol->phys_blocksize,
+                                (UINTN)count * vol->phys_blocksize,
+                                buffer);
+   Volume->LastIOStatus = Status;
+
+   return Status;
+} // fsw_status_t fsw_efi_read_blocks()
+
+/**
+ * FSW interface function to get a block without copying it. File data (cache level 0)
+ * is handed out straight from the read cache, which keeps it there until the block is
+ * released, so it is neither cached twice nor copied twice. Metadata is left to the
+ * core block cache, which keeps it longer than the read cache could.
+ */
+
+fsw_status_t fsw_efi_block_get(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out) {
+   struct cache_data *ReadCache;
+   fsw_u8           *CachedBlock;
+
+   if (cache_level > 0)
+      return FSW_UNSUPPORTED;
+
+   CachedBlock = fsw_efi_cache_block(vol, phys_bno, &ReadCache);
+   if (CachedBlock == NULL)
+      return FSW_UNSUPPORTED;   // the core will read it on its own
+   ReadCache->Pins++;
+   ((FSW_VOLUME_DATA *)vol->host_data)->LastIOStatus = EFI_SUCCESS;
+   *buffer_out = CachedBlock;
+   return FSW_SUCCESS;
+} // fsw_status_t fsw_efi_block_get()
+
+/**
+ * FSW interface function to release a block. Blocks handed out by fsw_efi_block_get
+ * are recognized by their address; other blocks belong to the core block cache.
+ */
+
+fsw_status_t fsw_efi_block_release(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer) {
+   FSW_VOLUME_DATA  *Volume = (FSW_VOLUME_DATA *)vol->host_data;
+   UINTN            i;
+
+   if (Volume->Caches == NULL)
+      return FSW_UNSUPPORTED;
+   for (i = 0; i < Volume->CacheSets * Volume->CacheWays; i++) {
+      if (Volume->Caches[i].Pins > 0 &&
+          (fsw_u8 *)buffer >= Volume->Caches[i].Cache &&
+          (fsw_u8 *)buffer < Volume->Caches[i].Cache + Volume->ReadAroundMax) {
+         Volume->Caches[i].Pins--;
+         return FSW_SUCCESS;
+      }
+   }
+   return FSW_UNSUPPORTED;
+} // fsw_status_t fsw_efi_block_release()
+
 /**
  * Map FSW status codes to EFI status codes. The FSW_IO_ERROR code is only produced
  * by fsw_efi_read_block, so we map it back to the EFI status code remembered from
@@ -623,17 +1289,139 @@ EFI_STATUS EFIAPI fsw_efi_FileSystem_OpenVolume(IN EFI_FILE_IO_INTERFACE *This,
 {
     EFI_STATUS          Status;
     FSW_VOLUME_DATA     *Volume = FSW_VOLUME_FROM_FILE_SYSTEM(This);
+    EFI_TPL             OldTpl;
 
 #if DEBUG_LEVEL
     Print(L"fsw_efi_FileSystem_OpenVolume\n");
 #endif
 
-    fsw_efi_clear_cache();
+    FSW_EFI_LOCK(OldTpl);
+    fsw_efi_clear_cache(Volume);
     Status = fsw_efi_dnode_to_FileHandle(Volume->vol->root, Root);
+    FSW_EFI_UNLOCK(OldTpl);
 
     return Status;
 }
 
+/**
+ * Statistics protocol, GetStats function. Copies the volume's block cache and
+ * disk access counters. The core has no clock in the EFI environment, so the
+ * time spent in host reads is reported as zero.
+ */
+
+EFI_STATUS EFIAPI fsw_efi_Stats_GetStats(IN FSW_STATS_PROTOCOL *This,
+                                         OUT struct fsw_volume_stats *Stats)
+{
+    FSW_VOLUME_DATA     *Volume = FSW_VOLUME_FROM_STATS(This);
+
+    if (Stats == NULL)
+        return EFI_INVALID_PARAMETER;
+    if (Volume->vol == NULL)
+        return EFI_NOT_READY;
+
+    fsw_memcpy(Stats, &Volume->vol->stats, sizeof(struct fsw_volume_stats));
+    return EFI_SUCCESS;
+}
+
+/**
+ * Read from a file handle, dispatching based on the kind of file handle.
+ */
+
+static EFI_STATUS fsw_efi_read_dispatch(IN FSW_FILE_DATA *File,
+                                        IN OUT UINTN *BufferSize,
+                                        OUT VOID *Buffer)
+{
+    if (File->Type == FSW_EFI_FILE_TYPE_FILE)
+        return fsw_efi_file_read(File, BufferSize, Buffer);
+    else if (File->Type == FSW_EFI_FILE_TYPE_DIR)
+        return fsw_efi_dir_read(File, BufferSize, Buffer);
+    return EFI_UNSUPPORTED;
+}
+
+#ifdef EFI_FILE_PROTOCOL_REVISION2
+
+/**
+ * Carry out a ReadEx request and signal its token's event.
+ */
+
+static VOID fsw_efi_read_task_run(IN struct fsw_efi_read_task *Task)
+{
+    FSW_FILE_DATA      *File = FSW_FILE_FROM_FILE_HANDLE(Task->FileHandle);
+
+    Task->Token->Status = fsw_efi_read_dispatch(File, &Task->Token->BufferSize, Task->Token->Buffer);
+    File->PendingReads--;
+    refit_call1_wrapper(BS->SignalEvent, Task->Token->Event);
+    FreePool(Task);
+}
+
+/**
+ * Notification function of a volume's ReadEvent. Carries out all queued ReadEx
+ * requests in order.
+ */
+
+static VOID EFIAPI fsw_efi_read_notify(IN EFI_EVENT Event, IN VOID *Context)
+{
+    FSW_VOLUME_DATA     *Volume = (FSW_VOLUME_DATA *)Context;
+    struct fsw_efi_read_task *Task;
+
+    while (Volume->ReadQueue != NULL) {
+        Task = Volume->ReadQueue;
+        Volume->ReadQueue = Task->Next;
+        if (Volume->ReadQueue == NULL)
+            Volume->ReadQueueTail = &Volume->ReadQueue;
+        fsw_efi_read_task_run(Task);
+    }
+}
+
+/**
+ * Carry out the ReadEx requests pending on a file handle right away. Called
+ * before anything else that depends on or changes the handle's position, so the
+ * requests behave as if they had completed in the order they were made.
+ */
+
+VOID fsw_efi_read_drain(IN FSW_FILE_DATA *File)
+{
+    FSW_VOLUME_DATA     *Volume = (FSW_VOLUME_DATA *)File->shand.dnode->vol->host_data;
+    struct fsw_efi_read_task **Link, *Task;
+
+    Link = &Volume->ReadQueue;
+    while (File->PendingReads > 0 && *Link != NULL) {
+        Task = *Link;
+        if (Task->FileHandle != &File->FileHandle) {
+            Link = &Task->Next;
+            continue;
+        }
+        *Link = Task->Next;
+        if (*Link == NULL)
+            Volume->ReadQueueTail = Link;
+        fsw_efi_read_task_run(Task);
+    }
+}
+
+/**
+ * Complete all queued ReadEx requests of a volume with EFI_ABORTED, without
+ * reading anything, and stop its ReadEvent. Used when the volume goes away.
+ */
+
+VOID fsw_efi_read_abort(IN FSW_VOLUME_DATA *Volume)
+{
+    struct fsw_efi_read_task *Task;
+
+    if (Volume->ReadEvent != NULL)
+        refit_call3_wrapper(BS->SetTimer, Volume->ReadEvent, TimerCancel, 0);
+    while (Volume->ReadQueue != NULL) {
+        Task = Volume->ReadQueue;
+        Volume->ReadQueue = Task->Next;
+        Task->Token->Status = EFI_ABORTED;
+        FSW_FILE_FROM_FILE_HANDLE(Task->FileHandle)->PendingReads--;
+        refit_call1_wrapper(BS->SignalEvent, Task->Token->Event);
+        FreePool(Task);
+    }
+    Volume->ReadQueueTail = &Volume->ReadQueue;
+}
+
+#endif
+
 /**
  * File Handle EFI protocol, Open function. Dispatches the call
  * based on the kind of file handle.
@@ -646,28 +1434,43 @@ EFI_STATUS EFIAPI fsw_efi_FileHandle_Open(IN EFI_FILE *This,
                                           IN UINT64 Attributes)
 {
     FSW_FILE_DATA      *File = FSW_FILE_FROM_FILE_HANDLE(This);
+    EFI_STATUS          Status;
+    EFI_TPL             OldTpl;
 
-    if (File->Type == FSW_EFI_FILE_TYPE_DIR)
-        return fsw_efi_dir_open(File, NewHandle, FileName, OpenMode, Attributes);
     // not supported for regular files
-    return EFI_UNSUPPORTED;
+    if (File->Type != FSW_EFI_FILE_TYPE_DIR)
+        return EFI_UNSUPPORTED;
+
+    FSW_EFI_LOCK(OldTpl);
+    Status = fsw_efi_dir_open(File, NewHandle, FileName, OpenMode, Attributes);
+    FSW_EFI_UNLOCK(OldTpl);
+    return Status;
 }
 
 /**
- * File Handle EFI protocol, Close function. Closes the FSW shandle
- * and frees the memory used for the structure.
+ * File Handle EFI protocol, Close function. Carries out the ReadEx requests
+ * still pending on the handle, closes the FSW shandle and frees the memory
+ * used for the structure.
  */
 
 EFI_STATUS EFIAPI fsw_efi_FileHandle_Close(IN EFI_FILE *This)
 {
     FSW_FILE_DATA      *File = FSW_FILE_FROM_FILE_HANDLE(This);
+    EFI_TPL             OldTpl;
 
 #if DEBUG_LEVEL
     Print(L"fsw_efi_FileHandle_Close\n");
 #endif
 
+    FSW_EFI_LOCK(OldTpl);
+    fsw_efi_read_drain(File);
+    if (File->DirRecords != NULL) {
+        fsw_efi_dir_flush(File);
+        FreePool(File->DirRecords);
+    }
     fsw_shandle_close(&File->shand);
     FreePool(File);
+    FSW_EFI_UNLOCK(OldTpl);
 
     return EFI_SUCCESS;
 }
@@ -700,12 +1503,14 @@ EFI_STATUS EFIAPI fsw_efi_FileHandle_Read(IN EFI_FILE *This,
                                           OUT VOID *Buffer)
 {
     FSW_FILE_DATA      *File = FSW_FILE_FROM_FILE_HANDLE(This);
+    EFI_STATUS          Status;
+    EFI_TPL             OldTpl;
 
-    if (File->Type == FSW_EFI_FILE_TYPE_FILE)
-        return fsw_efi_file_read(File, BufferSize, Buffer);
-    else if (File->Type == FSW_EFI_FILE_TYPE_DIR)
-        return fsw_efi_dir_read(File, BufferSize, Buffer);
-    return EFI_UNSUPPORTED;
+    FSW_EFI_LOCK(OldTpl);
+    fsw_efi_read_drain(File);
+    Status = fsw_efi_read_dispatch(File, BufferSize, Buffer);
+    FSW_EFI_UNLOCK(OldTpl);
+    return Status;
 }
 
 /**
@@ -730,11 +1535,18 @@ EFI_STATUS EFIAPI fsw_efi_FileHandle_GetPosition(IN EFI_FILE *This,
                                                  OUT UINT64 *Position)
 {
     FSW_FILE_DATA      *File = FSW_FILE_FROM_FILE_HANDLE(This);
+    EFI_STATUS          Status;
+    EFI_TPL             OldTpl;
 
-    if (File->Type == FSW_EFI_FILE_TYPE_FILE)
-        return fsw_efi_file_getpos(File, Position);
     // not defined for directories
-    return EFI_UNSUPPORTED;
+    if (File->Type != FSW_EFI_FILE_TYPE_FILE)
+        return EFI_UNSUPPORTED;
+
+    FSW_EFI_LOCK(OldTpl);
+    fsw_efi_read_drain(File);
+    Status = fsw_efi_file_getpos(File, Position);
+    FSW_EFI_UNLOCK(OldTpl);
+    return Status;
 }
 
 /**
@@ -746,12 +1558,17 @@ EFI_STATUS EFIAPI fsw_efi_FileHandle_SetPosition(IN EFI_FILE *This,
                                                  IN UINT64 Position)
 {
     FSW_FILE_DATA      *File = FSW_FILE_FROM_FILE_HANDLE(This);
+    EFI_STATUS          Status = EFI_UNSUPPORTED;
+    EFI_TPL             OldTpl;
 
+    FSW_EFI_LOCK(OldTpl);
+    fsw_efi_read_drain(File);
     if (File->Type == FSW_EFI_FILE_TYPE_FILE)
-        return fsw_efi_file_setpos(File, Position);
+        Status = fsw_efi_file_setpos(File, Position);
     else if (File->Type == FSW_EFI_FILE_TYPE_DIR)
-        return fsw_efi_dir_setpos(File, Position);
-    return EFI_UNSUPPORTED;
+        Status = fsw_efi_dir_setpos(File, Position);
+    FSW_EFI_UNLOCK(OldTpl);
+    return Status;
 }
 
 /**
@@ -765,8 +1582,13 @@ EFI_STATUS EFIAPI fsw_efi_FileHandle_GetInfo(IN EFI_FILE *This,
                                              OUT VOID *Buffer)
 {
     FSW_FILE_DATA      *File = FSW_FILE_FROM_FILE_HANDLE(This);
+    EFI_STATUS          Status;
+    EFI_TPL             OldTpl;
 
-    return fsw_efi_dnode_getinfo(File, InformationType, BufferSize, Buffer);
+    FSW_EFI_LOCK(OldTpl);
+    Status = fsw_efi_dnode_getinfo(File, InformationType, BufferSize, Buffer);
+    FSW_EFI_UNLOCK(OldTpl);
+    return Status;
 }
 
 /**
@@ -794,6 +1616,113 @@ EFI_STATUS EFIAPI fsw_efi_FileHandle_Flush(IN EFI_FILE *This)
     return EFI_WRITE_PROTECTED;
 }
 
+#ifdef EFI_FILE_PROTOCOL_REVISION2
+
+/**
+ * File Handle EFI protocol, OpenEx function. Opening a file does not wait for
+ * the disk long enough to be worth deferring, so this calls through to Open and
+ * signals the token's event right away.
+ */
+
+EFI_STATUS EFIAPI fsw_efi_FileHandle_OpenEx(IN EFI_FILE *This,
+                                            OUT EFI_FILE **NewHandle,
+                                            IN CHAR16 *FileName,
+                                            IN UINT64 OpenMode,
+                                            IN UINT64 Attributes,
+                                            IN OUT EFI_FILE_IO_TOKEN *Token)
+{
+    EFI_STATUS          Status;
+
+    if (Token == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    Status = refit_call5_wrapper(This->Open, This, NewHandle, FileName, OpenMode, Attributes);
+    Token->Status = Status;
+    if (!EFI_ERROR(Status) && Token->Event != NULL)
+        refit_call1_wrapper(BS->SignalEvent, Token->Event);
+    return Status;
+}
+
+/**
+ * File Handle EFI protocol, ReadEx function. Without an event in the token,
+ * this is a plain Read. Otherwise the request is queued and carried out from
+ * the volume's timer event, which signals the token's event when it is done;
+ * the caller can compute in the meantime.
+ */
+
+EFI_STATUS EFIAPI fsw_efi_FileHandle_ReadEx(IN EFI_FILE *This,
+                                            IN OUT EFI_FILE_IO_TOKEN *Token)
+{
+    FSW_FILE_DATA      *File = FSW_FILE_FROM_FILE_HANDLE(This);
+    FSW_VOLUME_DATA    *Volume = (FSW_VOLUME_DATA *)File->shand.dnode->vol->host_data;
+    struct fsw_efi_read_task *Task;
+    EFI_STATUS          Status;
+    EFI_TPL             OldTpl;
+
+    if (Token == NULL)
+        return EFI_INVALID_PARAMETER;
+    if (Token->Event == NULL) {
+        Token->Status = refit_call3_wrapper(This->Read, This, &Token->BufferSize, Token->Buffer);
+        return Token->Status;
+    }
+
+    Task = AllocatePool(sizeof(struct fsw_efi_read_task));
+    if (Task == NULL)
+        return EFI_OUT_OF_RESOURCES;
+    Task->Next = NULL;
+    Task->FileHandle = This;
+    Task->Token = Token;
+
+    FSW_EFI_LOCK(OldTpl);
+    Status = EFI_SUCCESS;
+    if (Volume->ReadEvent == NULL) {
+        Status = refit_call5_wrapper(BS->CreateEvent, EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+                                     fsw_efi_read_notify, Volume, &Volume->ReadEvent);
+        if (EFI_ERROR(Status))
+            Volume->ReadEvent = NULL;
+    }
+    if (!EFI_ERROR(Status))   // on the next timer tick
+        Status = refit_call3_wrapper(BS->SetTimer, Volume->ReadEvent, TimerRelative, 0);
+    if (!EFI_ERROR(Status)) {
+        if (Volume->ReadQueue == NULL)
+            Volume->ReadQueueTail = &Volume->ReadQueue;
+        *Volume->ReadQueueTail = Task;
+        Volume->ReadQueueTail = &Task->Next;
+        File->PendingReads++;
+    } else {
+        FreePool(Task);
+    }
+    FSW_EFI_UNLOCK(OldTpl);
+
+    return Status;
+}
+
+/**
+ * File Handle EFI protocol, WriteEx function. Returns unsupported status
+ * because this driver is read-only.
+ */
+
+EFI_STATUS EFIAPI fsw_efi_FileHandle_WriteEx(IN EFI_FILE *This,
+                                             IN OUT EFI_FILE_IO_TOKEN *Token)
+{
+    // this driver is read-only
+    return EFI_WRITE_PROTECTED;
+}
+
+/**
+ * File Handle EFI protocol, FlushEx function. Returns unsupported status
+ * because this driver is read-only.
+ */
+
+EFI_STATUS EFIAPI fsw_efi_FileHandle_FlushEx(IN EFI_FILE *This,
+                                             IN OUT EFI_FILE_IO_TOKEN *Token)
+{
+    // this driver is read-only
+    return EFI_WRITE_PROTECTED;
+}
+
+#endif
+
 /**
  * Set up a file handle for a dnode. This function allocates a data structure
  * for a file handle, opens a FSW shandle and populates the EFI_FILE structure
@@ -843,6 +1772,13 @@ EFI_STATUS fsw_efi_dnode_to_FileHandle(IN struct fsw_dnode *dno,
     File->FileHandle.GetInfo     = fsw_efi_FileHandle_GetInfo;
     File->FileHandle.SetInfo     = fsw_efi_FileHandle_SetInfo;
     File->FileHandle.Flush       = fsw_efi_FileHandle_Flush;
+#ifdef EFI_FILE_PROTOCOL_REVISION2
+    File->FileHandle.Revision    = EFI_FILE_PROTOCOL_REVISION2;
+    File->FileHandle.OpenEx      = fsw_efi_FileHandle_OpenEx;
+    File->FileHandle.ReadEx      = fsw_efi_FileHandle_ReadEx;
+    File->FileHandle.WriteEx     = fsw_efi_FileHandle_WriteEx;
+    File->FileHandle.FlushEx     = fsw_efi_FileHandle_FlushEx;
+#endif
 
     *NewFileHandle = &File->FileHandle;
     return EFI_SUCCESS;
@@ -948,7 +1884,10 @@ EFI_STATUS fsw_efi_dir_open(IN FSW_FILE_DATA *File,
 
 /**
  * Read function for directories. A file handle read on a directory retrieves
- * the next directory entry.
+ * the next directory entry. Entries are read from the file system in batches
+ * into a buffer kept with the file handle, so most calls only copy out an entry
+ * that is already complete. An entry that does not fit into the caller's buffer
+ * stays in the buffer for the next call.
  */
 
 EFI_STATUS fsw_efi_dir_read(IN FSW_FILE_DATA *File,
@@ -957,29 +1896,56 @@ EFI_STATUS fsw_efi_dir_read(IN FSW_FILE_DATA *File,
 {
     EFI_STATUS          Status;
     FSW_VOLUME_DATA     *Volume = (FSW_VOLUME_DATA *)File->shand.dnode->vol->host_data;
-    struct fsw_dnode    *dno;
+    struct fsw_dir_record *Record;
+    fsw_u32             Count;
 
 #if DEBUG_LEVEL
     Print(L"fsw_efi_dir_read...\n");
 #endif
 
-    // read the next entry
-    Status = fsw_efi_map_status(fsw_dnode_dir_read(&File->shand, &dno), Volume);
-    if (Status == EFI_NOT_FOUND) {
-        // end of directory
-        *BufferSize = 0;
+    // read the next batch of entries
+    if (File->DirIndex >= File->DirCount) {
+        if (File->DirRecords == NULL) {
+            File->DirRecords = AllocatePool(FSW_EFI_DIR_BATCH * sizeof(struct fsw_dir_record));
+            if (File->DirRecords == NULL)
+                return EFI_OUT_OF_RESOURCES;
+        }
+        fsw_efi_dir_flush(File);
+        Status = fsw_efi_map_status(fsw_dnode_dir_read_batch(&File->shand, File->DirRecords,
+                                                             FSW_EFI_DIR_BATCH, &Count), Volume);
+        if (Status == EFI_NOT_FOUND) {
+            // end of directory
+            *BufferSize = 0;
 #if DEBUG_LEVEL
-        Print(L"...no more entries\n");
+            Print(L"...no more entries\n");
 #endif
-        return EFI_SUCCESS;
+            return EFI_SUCCESS;
+        }
+        if (EFI_ERROR(Status))
+            return Status;
+        File->DirCount = Count;
     }
+
+    // get info into buffer
+    Record = &File->DirRecords[File->DirIndex];
+    Status = fsw_efi_dnode_fill_FileInfo(Volume, Record->dnode, BufferSize, Buffer);
     if (EFI_ERROR(Status))
         return Status;
+    fsw_dnode_release(Record->dnode);
+    File->DirIndex++;
+    return EFI_SUCCESS;
+}
 
-    // get info into buffer
-    Status = fsw_efi_dnode_fill_FileInfo(Volume, dno, BufferSize, Buffer);
-    fsw_dnode_release(dno);
-    return Status;
+/**
+ * Drop the directory entries that were read ahead but not returned yet.
+ */
+
+VOID fsw_efi_dir_flush(IN FSW_FILE_DATA *File)
+{
+    if (File->DirIndex < File->DirCount)
+        fsw_dir_records_release(File->DirRecords + File->DirIndex, File->DirCount - File->DirIndex);
+    File->DirCount = 0;
+    File->DirIndex = 0;
 }
 
 /**
@@ -991,6 +1957,7 @@ EFI_STATUS fsw_efi_dir_read(IN FSW_FILE_DATA *File,
 EFI_STATUS fsw_efi_dir_setpos(IN FSW_FILE_DATA *File, IN UINT64 Position)
 {
     if (Position == 0) {
+        fsw_efi_dir_flush(File);
         File->shand.pos = 0;
         return EFI_SUCCESS;
     } else {
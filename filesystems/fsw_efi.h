@@ -42,6 +42,55 @@
 
 #ifdef __MAKEWITH_GNUEFI
 #define CompareGuid(a, b) CompareGuid(a, b)==0
+#include "edk2/DiskIo2.h"
+#endif
+
+/** GUID of the protocol giving access to a volume's fsw_volume_stats counters. */
+#define FSW_STATS_PROTOCOL_GUID \
+  { \
+    0xe22de6d2, 0x8528, 0x4cbc, {0xb8, 0x13, 0xd9, 0x95, 0xeb, 0x60, 0xa9, 0xec } \
+  }
+
+/** Revision of FSW_STATS_PROTOCOL, changes when struct fsw_volume_stats does. */
+#define FSW_STATS_PROTOCOL_REVISION  (0x00010000)
+
+typedef struct _FSW_STATS_PROTOCOL FSW_STATS_PROTOCOL;
+
+/**
+ * EFI Host: Protocol installed next to the SimpleFileSystem protocol of each
+ * mounted volume. GetStats copies the volume's counters into Stats, so tools
+ * can look at the block cache and disk access without a debug build.
+ */
+
+struct _FSW_STATS_PROTOCOL {
+    UINT64                      Revision;       //!< FSW_STATS_PROTOCOL_REVISION
+    EFI_STATUS (EFIAPI *GetStats)(IN FSW_STATS_PROTOCOL *This,
+                                  OUT struct fsw_volume_stats *Stats);
+};
+
+/**
+ * EFI Host: One window of a volume's read cache.
+ */
+
+struct cache_data {
+   fsw_u8            *Cache;      // ReadAroundMax bytes of disk data, allocated on first use
+   fsw_u64           CacheStart;  // Disk offset of the window, a multiple of ReadAroundMax
+   UINTN             ValidStart;  // Range of Cache[] that has been read from the disk
+   UINTN             ValidEnd;
+   UINTN             Pins;        // Blocks handed out by fsw_efi_block_get() and not yet released
+   UINT64            LastUse;     // Value of the volume's CacheTick at the last hit
+};
+
+#ifdef EFI_FILE_PROTOCOL_REVISION2
+/**
+ * EFI Host: A ReadEx request waiting to be carried out.
+ */
+
+struct fsw_efi_read_task {
+   struct fsw_efi_read_task *Next;
+   EFI_FILE             *FileHandle;  // Handle the request was made on
+   EFI_FILE_IO_TOKEN    *Token;       // Caller's token, signalled when done
+};
 #endif
 
 /**
@@ -52,20 +101,56 @@ typedef struct {
     UINT64                      Signature;      //!< Used to identify this structure
 
     EFI_FILE_IO_INTERFACE       FileSystem;     //!< Published EFI protocol interface structure
+    FSW_STATS_PROTOCOL          Stats;          //!< Published statistics protocol interface structure
 
     EFI_HANDLE                  Handle;         //!< The device handle the protocol is attached to
     EFI_DISK_IO                 *DiskIo;        //!< The Disk I/O protocol we use for disk access
+    EFI_DISK_IO2_PROTOCOL       *DiskIo2;       //!< The Disk I/O 2 protocol used for prefetching, if available
     UINT32                      MediaId;        //!< The media ID from the Block I/O protocol
     EFI_STATUS                  LastIOStatus;   //!< Last status from Disk I/O
 
     struct fsw_volume           *vol;           //!< FSW volume structure
 
+    struct cache_data           *Caches;        //!< Read cache, CacheSets sets of CacheWays windows each
+    UINTN                       CacheSets;      //!< Number of sets in the read cache
+    UINTN                       CacheWays;      //!< Number of windows per set
+    UINT64                      CacheTick;      //!< Counter for finding the least recently used window
+    UINT64                      CacheHits;      //!< Statistics: blocks found in the read cache
+    UINT64                      CacheMisses;    //!< Statistics: disk reads for the read cache
+    UINT64                      CacheMissBytes; //!< Statistics: bytes read for the read cache
+
+    UINTN                       ReadAround;     //!< Bytes read around a block on a cache miss
+    UINTN                       ReadAroundMin;  //!< Bounds for ReadAround; ReadAroundMax is also
+    UINTN                       ReadAroundMax;  //!<  the size of a read cache window
+    UINTN                       ReadAroundShift; //!< log2(ReadAroundMax)
+    UINT64                      LastMissEnd;    //!< Disk offset following the last read cache miss
+    UINTN                       SeqMisses;      //!< Consecutive misses continuing the previous one
+    UINTN                       ScatteredMisses; //!< Consecutive misses far from the previous one
+
+    EFI_DISK_IO2_TOKEN          *PrefetchToken; //!< Token of the prefetch in flight, allocated on first use
+    struct cache_data           *PrefetchEntry; //!< Window being prefetched into, NULL if none
+    UINTN                       PrefetchStart;  //!< Range of that window being read
+    UINTN                       PrefetchEnd;
+    UINT64                      PrefetchTrigger; //!< Disk offset of the last prefetch; a hit there
+    UINT64                      PrefetchNext;   //!<  starts the next prefetch, at PrefetchNext
+    UINT64                      Prefetches;     //!< Statistics: prefetches issued
+    UINT64                      PrefetchWaits;  //!< Statistics: prefetches waited for
+    UINT64                      PrefetchTimeouts; //!< Statistics: prefetches timed out; none are started after one
+
+#ifdef EFI_FILE_PROTOCOL_REVISION2
+    struct fsw_efi_read_task    *ReadQueue;     //!< ReadEx requests in the order they were made
+    struct fsw_efi_read_task    **ReadQueueTail;
+    EFI_EVENT                   ReadEvent;      //!< Timer event carrying out the ReadEx requests
+#endif
+
 } FSW_VOLUME_DATA;
 
 /** Signature for the volume structure. */
 #define FSW_VOLUME_DATA_SIGNATURE  EFI_SIGNATURE_32 ('f', 's', 'w', 'V')
 /** Access macro for the volume structure. */
 #define FSW_VOLUME_FROM_FILE_SYSTEM(a)  CR (a, FSW_VOLUME_DATA, FileSystem, FSW_VOLUME_DATA_SIGNATURE)
+/** Access macro for the volume structure. */
+#define FSW_VOLUME_FROM_STATS(a)  CR (a, FSW_VOLUME_DATA, Stats, FSW_VOLUME_DATA_SIGNATURE)
 
 /**
  * EFI Host: Private structure for a EFI_FILE interface.
@@ -79,6 +164,14 @@ typedef struct {
     UINT64                       Type;           //!< File type used for dispatching
     struct fsw_shandle          shand;          //!< FSW handle for this file
 
+    struct fsw_dir_record       *DirRecords;    //!< Directory entries read ahead in one batch, allocated on first use
+    UINT32                      DirCount;       //!< Number of entries in DirRecords
+    UINT32                      DirIndex;       //!< Next entry in DirRecords to return
+
+#ifdef EFI_FILE_PROTOCOL_REVISION2
+    UINTN                       PendingReads;   //!< ReadEx requests on this handle not yet carried out
+#endif
+
 } FSW_FILE_DATA;
 
 /** File type: regular file. */
@@ -86,6 +179,9 @@ typedef struct {
 /** File type: directory. */
 #define FSW_EFI_FILE_TYPE_DIR   (1)
 
+/** Number of directory entries read ahead per directory handle. */
+#define FSW_EFI_DIR_BATCH       (16)
+
 /** Signature for the file handle structure. */
 #define FSW_FILE_DATA_SIGNATURE    EFI_SIGNATURE_32 ('f', 's', 'w', 'F')
 /** Access macro for the file handle structure. */
@@ -59,12 +59,15 @@
 # include <Protocol/SimpleFileSystem.h>
 # include <Protocol/BlockIo.h>
 # include <Protocol/DiskIo.h>
+# include <Protocol/DiskIo2.h>
 # include <Guid/FileSystemInfo.h>
 # include <Guid/FileInfo.h>
 # include <Guid/FileSystemVolumeLabelInfo.h>
 # include <Protocol/ComponentName.h>
+# include <Protocol/LoadedImage.h>
 
 # define BS gBS
+# define LoadedImageProtocol gEfiLoadedImageProtocolGuid
 
 # define EFI_FILE_HANDLE_REVISION EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION
 # define SIZE_OF_EFI_FILE_SYSTEM_VOLUME_LABEL_INFO  SIZE_OF_EFI_FILE_SYSTEM_VOLUME_LABEL
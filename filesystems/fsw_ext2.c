@@ -26,6 +26,7 @@
 
 // functions
 
+static fsw_status_t fsw_ext2_volume_probe(void *head, fsw_u32 head_size);
 static fsw_status_t fsw_ext2_volume_mount(struct fsw_ext2_volume *vol);
 static void         fsw_ext2_volume_free(struct fsw_ext2_volume *vol);
 static fsw_status_t fsw_ext2_volume_stat(struct fsw_ext2_volume *vol, struct fsw_volume_stat *sb);
@@ -41,6 +42,9 @@ static fsw_status_t fsw_ext2_dir_lookup(struct fsw_ext2_volume *vol, struct fsw_
                                         struct fsw_string *lookup_name, struct fsw_ext2_dnode **child_dno);
 static fsw_status_t fsw_ext2_dir_read(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
                                       struct fsw_shandle *shand, struct fsw_ext2_dnode **child_dno);
+static fsw_status_t fsw_ext2_dir_read_batch(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                            struct fsw_shandle *shand, struct fsw_dir_record *records,
+                                            fsw_u32 max_count, fsw_u32 *count_out);
 static fsw_status_t fsw_ext2_read_dentry(struct fsw_shandle *shand, struct ext2_dir_entry *entry);
 
 static fsw_status_t fsw_ext2_readlink(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
@@ -65,8 +69,41 @@ struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(ext2) = {
     fsw_ext2_dir_lookup,
     fsw_ext2_dir_read,
     fsw_ext2_readlink,
+    fsw_ext2_dir_read_batch,
+    EXT2_SUPERBLOCK_BLOCKNO * EXT2_SUPERBLOCK_BLOCKSIZE + sizeof(struct ext2_super_block),
+    fsw_ext2_volume_probe,
 };
 
+/**
+ * Check the superblock's magic number, revision and incompatible features.
+ */
+
+static fsw_status_t fsw_ext2_check_superblock(struct ext2_super_block *sb)
+{
+    if (sb->s_magic != EXT2_SUPER_MAGIC)
+        return FSW_UNSUPPORTED;
+    if (sb->s_rev_level != EXT2_GOOD_OLD_REV &&
+        sb->s_rev_level != EXT2_DYNAMIC_REV)
+        return FSW_UNSUPPORTED;
+    if (sb->s_rev_level == EXT2_DYNAMIC_REV &&
+        (sb->s_feature_incompat & ~(EXT2_FEATURE_INCOMPAT_FILETYPE | EXT3_FEATURE_INCOMPAT_RECOVER)))
+        return FSW_UNSUPPORTED;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Probe for an ext2 volume. Applies the mount time superblock checks to
+ * the superblock in the given head of the volume.
+ */
+
+static fsw_status_t fsw_ext2_volume_probe(void *head, fsw_u32 head_size)
+{
+    if (head_size < EXT2_SUPERBLOCK_BLOCKNO * EXT2_SUPERBLOCK_BLOCKSIZE + sizeof(struct ext2_super_block))
+        return FSW_UNSUPPORTED;
+    return fsw_ext2_check_superblock((struct ext2_super_block *)
+                                     ((fsw_u8 *)head + EXT2_SUPERBLOCK_BLOCKNO * EXT2_SUPERBLOCK_BLOCKSIZE));
+}
+
 /**
  * Mount an ext2 volume. Reads the superblock and constructs the
  * root directory dnode.
@@ -96,14 +133,9 @@ static fsw_status_t fsw_ext2_volume_mount(struct fsw_ext2_volume *vol)
     fsw_block_release(vol, EXT2_SUPERBLOCK_BLOCKNO, buffer);
 
     // check the superblock
-    if (vol->sb->s_magic != EXT2_SUPER_MAGIC)
-        return FSW_UNSUPPORTED;
-    if (vol->sb->s_rev_level != EXT2_GOOD_OLD_REV &&
-        vol->sb->s_rev_level != EXT2_DYNAMIC_REV)
-        return FSW_UNSUPPORTED;
-    if (vol->sb->s_rev_level == EXT2_DYNAMIC_REV &&
-        (vol->sb->s_feature_incompat & ~(EXT2_FEATURE_INCOMPAT_FILETYPE | EXT3_FEATURE_INCOMPAT_RECOVER)))
-        return FSW_UNSUPPORTED;
+    status = fsw_ext2_check_superblock(vol->sb);
+    if (status)
+        return status;
 
     /*
      if (vol->sb->s_rev_level == EXT2_DYNAMIC_REV &&
@@ -137,6 +169,9 @@ static fsw_status_t fsw_ext2_volume_mount(struct fsw_ext2_volume *vol)
     status = fsw_alloc(sizeof(fsw_u32) * groupcnt, &vol->inotab_bno);
     if (status)
         return status;
+    // the descriptor blocks follow each other, read them in one go
+    fsw_block_readahead(vol, vol->sb->s_first_data_block + 1,
+                        (groupcnt + gdesc_per_block - 1) / gdesc_per_block, 1);
     for (groupno = 0; groupno < groupcnt; groupno++) {
         // get the block group descriptor
         gdesc_bno = (vol->sb->s_first_data_block + 1) + groupno / gdesc_per_block;
@@ -234,6 +269,20 @@ static fsw_status_t fsw_ext2_dnode_fill(struct fsw_ext2_volume *vol, struct fsw_
     return FSW_SUCCESS;
 }
 
+/**
+ * Free the block map of a dnode, so that it is decoded anew when needed next.
+ */
+
+static void fsw_ext2_map_free(struct fsw_ext2_dnode *dno)
+{
+    if (dno->runs)
+        fsw_free(dno->runs);
+    if (dno->map_done)
+        fsw_free(dno->map_done);
+    dno->runs = NULL;
+    dno->map_done = NULL;
+}
+
 /**
  * Free the dnode data structure. Called by the core when deallocating a dnode
  * structure to release the memory used by the file system type specific part
@@ -244,6 +293,7 @@ static void fsw_ext2_dnode_free(struct fsw_ext2_volume *vol, struct fsw_ext2_dno
 {
     if (dno->raw)
         fsw_free(dno->raw);
+    fsw_ext2_map_free(dno);
 }
 
 /**
@@ -266,105 +316,258 @@ static fsw_status_t fsw_ext2_dnode_stat(struct fsw_ext2_volume *vol, struct fsw_
 }
 
 /**
- * Retrieve file data mapping information. This function is called by the core when
- * fsw_shandle_read needs to know where on the disk the required piece of the file's
- * data can be found. The core makes sure that fsw_ext2_dnode_fill has been called
- * on the dnode before. Our task here is to get the physical disk block number for
- * the requested logical block number.
- *
- * The ext2 file system does not use extents, but stores a list of block numbers
- * using the usual direct, indirect, double-indirect, triple-indirect scheme. To
- * optimize access, this function checks if the following file blocks are mapped
- * to consecutive disk blocks and returns a combined extent if possible.
+ * Return the block map chunk a logical block belongs to. Chunk 0 holds the direct
+ * block pointers in the inode, every further chunk holds the block pointers of one
+ * indirect block, in file order.
  */
 
-static fsw_status_t fsw_ext2_get_extent(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
-                                        struct fsw_extent *extent)
+static fsw_u32 fsw_ext2_map_chunk_of(struct fsw_ext2_volume *vol, fsw_u32 bno)
 {
-    fsw_status_t    status;
-    fsw_u32         bno, release_bno, buf_bcnt, file_bcnt;
-    fsw_u32         *buffer;
-    int             path[5], i;
+    if (bno < EXT2_NDIR_BLOCKS)
+        return 0;
+    return 1 + (bno - EXT2_NDIR_BLOCKS) / vol->ind_bcnt;
+}
 
-    // Preconditions: The caller has checked that the requested logical block
-    //  is within the file's size. The dnode has complete information, i.e.
-    //  fsw_ext2_dnode_read_info was called successfully on it.
+/**
+ * Return the number of runs in the block map that start at or before a logical
+ * block. This is the index of the run that follows the block.
+ */
 
-    extent->type = FSW_EXTENT_TYPE_PHYSBLOCK;
-    extent->log_count = 1;
-    bno = extent->log_start;
+static fsw_u32 fsw_ext2_map_find(struct fsw_ext2_dnode *dno, fsw_u32 bno)
+{
+    fsw_u32         lo, hi, mid;
+
+    lo = 0;
+    hi = dno->run_count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (dno->runs[mid].log_start <= bno)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Add one mapped block to the block map, at the index where the runs of its chunk
+ * are being inserted. The block extends the run before it if it continues that run
+ * on disk, otherwise it starts a new run. A run that meets the one after it is
+ * merged with it.
+ */
+
+static fsw_status_t fsw_ext2_map_add_block(struct fsw_ext2_dnode *dno, fsw_u32 *pos,
+                                           fsw_u32 log_bno, fsw_u32 phys_bno)
+{
+    fsw_status_t    status;
+    struct fsw_ext2_run *run, *new_runs;
+    fsw_u32         i;
 
-    // try direct block pointers in the inode
-    if (bno < EXT2_NDIR_BLOCKS) {
-        path[0] = bno;
-        path[1] = -1;
+    run = (*pos > 0) ? &dno->runs[*pos - 1] : NULL;
+    if (run != NULL && run->log_start + run->log_count == log_bno &&
+        run->phys_start + run->log_count == phys_bno) {
+        run->log_count++;
     } else {
-        bno -= EXT2_NDIR_BLOCKS;
+        if (dno->run_count == dno->run_alloc) {
+            status = fsw_alloc(2 * dno->run_alloc * sizeof(struct fsw_ext2_run), &new_runs);
+            if (status)
+                return status;
+            fsw_memcpy(new_runs, dno->runs, dno->run_count * sizeof(struct fsw_ext2_run));
+            fsw_free(dno->runs);
+            dno->runs = new_runs;
+            dno->run_alloc *= 2;
+        }
+        for (i = dno->run_count; i > *pos; i--)
+            dno->runs[i] = dno->runs[i - 1];
+        dno->run_count++;
+        run = &dno->runs[(*pos)++];
+        run->log_start = log_bno;
+        run->log_count = 1;
+        run->phys_start = phys_bno;
+    }
+
+    // merge with the following run
+    if (*pos < dno->run_count &&
+        run->log_start + run->log_count == run[1].log_start &&
+        run->phys_start + run->log_count == run[1].phys_start) {
+        run->log_count += run[1].log_count;
+        dno->run_count--;
+        for (i = *pos; i < dno->run_count; i++)
+            dno->runs[i] = dno->runs[i + 1];
+    }
+    return FSW_SUCCESS;
+}
+
+/**
+ * Decode one chunk of block pointers into the block map. For an indirect chunk,
+ * this walks down from the inode to the indirect block that holds the pointers.
+ * A missing indirect block anywhere on the way leaves the whole chunk a hole.
+ */
+
+static fsw_status_t fsw_ext2_map_chunk(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                       fsw_u32 chunk)
+{
+    fsw_status_t    status;
+    fsw_u32         log_start, count, ind, bno, release_bno, pos, i;
+    fsw_u32         *buffer;
+    int             path[4], level;
 
-        // try indirect block
-        if (bno < vol->ind_bcnt) {
+    // find the indirect block that holds the chunk
+    if (chunk == 0) {
+        log_start = 0;
+        count = EXT2_NDIR_BLOCKS;
+        path[0] = -1;
+    } else {
+        ind = chunk - 1;
+        log_start = EXT2_NDIR_BLOCKS + ind * vol->ind_bcnt;
+        count = vol->ind_bcnt;
+        if (ind == 0) {
             path[0] = EXT2_IND_BLOCK;
-            path[1] = bno;
-            path[2] = -1;
+            path[1] = -1;
         } else {
-            bno -= vol->ind_bcnt;
-
-            // try double-indirect block
-            if (bno < vol->dind_bcnt) {
+            ind -= 1;
+            if (ind < vol->ind_bcnt) {
                 path[0] = EXT2_DIND_BLOCK;
-                path[1] = bno / vol->ind_bcnt;
-                path[2] = bno % vol->ind_bcnt;
-                path[3] = -1;
+                path[1] = ind;
+                path[2] = -1;
             } else {
-                bno -= vol->dind_bcnt;
-
-                // use the triple-indirect block
+                ind -= vol->ind_bcnt;
+                if (ind / vol->ind_bcnt >= vol->ind_bcnt)
+                    return FSW_VOLUME_CORRUPTED;    // beyond the reach of the triple-indirect block
                 path[0] = EXT2_TIND_BLOCK;
-                path[1] = bno / vol->dind_bcnt;
-                path[2] = (bno / vol->ind_bcnt) % vol->ind_bcnt;
-                path[3] = bno % vol->ind_bcnt;
-                path[4] = -1;
+                path[1] = ind / vol->ind_bcnt;
+                path[2] = ind % vol->ind_bcnt;
+                path[3] = -1;
             }
         }
     }
+    if (count > dno->map_bcnt - log_start)
+        count = dno->map_bcnt - log_start;
 
     // follow the indirection path
     buffer = dno->raw->i_block;
-    buf_bcnt = EXT2_NDIR_BLOCKS;
     release_bno = 0;
-    for (i = 0; ; i++) {
-        bno = buffer[path[i]];
-        if (bno == 0) {
-            extent->type = FSW_EXTENT_TYPE_SPARSE;
-            if (release_bno)
-                fsw_block_release(vol, release_bno, buffer);
-            return FSW_SUCCESS;
-        }
-        if (path[i+1] < 0)
-            break;
-
+    for (level = 0; path[level] >= 0; level++) {
+        bno = buffer[path[level]];
         if (release_bno)
             fsw_block_release(vol, release_bno, buffer);
+        release_bno = 0;
+        if (bno == 0)
+            break;
         status = fsw_block_get(vol, bno, 1, (void **)&buffer);
         if (status)
             return status;
         release_bno = bno;
-        buf_bcnt = vol->ind_bcnt;
     }
-    extent->phys_start = bno;
-
-    // check if the following blocks can be aggregated into one extent
-    file_bcnt = (fsw_u32)((dno->g.size + vol->g.log_blocksize - 1) & (vol->g.log_blocksize - 1));
-    while (path[i]           + extent->log_count < buf_bcnt &&    // indirect block has more block pointers
-           extent->log_start + extent->log_count < file_bcnt) {   // file has more blocks
-        if (buffer[path[i] + extent->log_count] == buffer[path[i] + extent->log_count - 1] + 1)
-            extent->log_count++;
-        else
-            break;
+
+    // the runs of the chunk go before all runs of later chunks
+    status = FSW_SUCCESS;
+    if (path[level] < 0) {
+        pos = fsw_ext2_map_find(dno, log_start);
+        for (i = 0; i < count && status == FSW_SUCCESS; i++) {
+            if (buffer[i])
+                status = fsw_ext2_map_add_block(dno, &pos, log_start + i, buffer[i]);
+        }
+        if (release_bno)
+            fsw_block_release(vol, release_bno, buffer);
+    }
+    if (status == FSW_SUCCESS)
+        dno->map_done[chunk >> 3] |= 1 << (chunk & 7);
+    return status;
+}
+
+/**
+ * Retrieve file data mapping information. This function is called by the core when
+ * fsw_shandle_read needs to know where on the disk the required piece of the file's
+ * data can be found. The core makes sure that fsw_ext2_dnode_fill has been called
+ * on the dnode before. Our task here is to get the physical disk block number for
+ * the requested logical block number.
+ *
+ * The ext2 file system does not use extents, but stores a list of block numbers
+ * using the usual direct, indirect, double-indirect, triple-indirect scheme. These
+ * are decoded into a per-dnode block map of runs of consecutive disk blocks, one
+ * indirect block at a time as the file is read. A run that reaches the end of an
+ * indirect block pulls in the next one, so that a file stored in one piece comes
+ * back as one extent. Reading the same part of the file again needs no metadata.
+ */
+
+static fsw_status_t fsw_ext2_get_extent(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                        struct fsw_extent *extent)
+{
+    fsw_status_t    status;
+    fsw_u32         bno, chunk, idx, run_end, count;
+    fsw_u64         file_bcnt;
+    struct fsw_ext2_run *run;
+
+    // Preconditions: The caller has checked that the requested logical block
+    //  is within the file's size. The dnode has complete information, i.e.
+    //  fsw_ext2_dnode_read_info was called successfully on it.
+
+    if (dno->runs == NULL) {
+        file_bcnt = FSW_U64_DIV(dno->g.size + vol->g.log_blocksize - 1, vol->g.log_blocksize);
+        dno->map_bcnt = (file_bcnt > 0xffffffffUL) ? 0xffffffffUL : (fsw_u32)file_bcnt;
+        dno->run_count = 0;
+        dno->run_alloc = 4;
+        status = fsw_alloc(dno->run_alloc * sizeof(struct fsw_ext2_run), &dno->runs);
+        if (status)
+            return status;
+        chunk = (dno->map_bcnt > 0) ? fsw_ext2_map_chunk_of(vol, dno->map_bcnt - 1) : 0;
+        status = fsw_alloc_zero(chunk / 8 + 1, (void **)&dno->map_done);
+        if (status) {
+            fsw_ext2_map_free(dno);
+            return status;
+        }
+    }
+
+    bno = extent->log_start;
+    if (bno >= dno->map_bcnt)
+        return FSW_VOLUME_CORRUPTED;
+    chunk = fsw_ext2_map_chunk_of(vol, bno);
+    if (!(dno->map_done[chunk >> 3] & (1 << (chunk & 7)))) {
+        status = fsw_ext2_map_chunk(vol, dno, chunk);
+        if (status) {
+            fsw_ext2_map_free(dno);
+            return status;
+        }
+    }
+
+    idx = fsw_ext2_map_find(dno, bno);
+    if (idx > 0 && bno - dno->runs[idx - 1].log_start < dno->runs[idx - 1].log_count) {
+        // a run that ends with its chunk may go on in the next one
+        idx--;
+        run_end = dno->runs[idx].log_start + dno->runs[idx].log_count;
+        while (run_end < dno->map_bcnt) {
+            chunk = fsw_ext2_map_chunk_of(vol, run_end);
+            if (dno->map_done[chunk >> 3] & (1 << (chunk & 7)))
+                break;
+            status = fsw_ext2_map_chunk(vol, dno, chunk);
+            if (status) {
+                fsw_ext2_map_free(dno);
+                return status;
+            }
+            if (dno->runs[idx].log_start + dno->runs[idx].log_count == run_end)
+                break;
+            run_end = dno->runs[idx].log_start + dno->runs[idx].log_count;
+        }
+
+        run = &dno->runs[idx];
+        extent->type = FSW_EXTENT_TYPE_PHYSBLOCK;
+        extent->phys_start = run->phys_start + (bno - run->log_start);
+        extent->log_count = run->log_start + run->log_count - bno;
+        return FSW_SUCCESS;
     }
 
-    if (release_bno)
-        fsw_block_release(vol, release_bno, buffer);
+    // a hole, up to the next run or the end of the chunk
+    if (chunk == 0)
+        count = EXT2_NDIR_BLOCKS - bno;
+    else
+        count = vol->ind_bcnt - (bno - EXT2_NDIR_BLOCKS) % vol->ind_bcnt;
+    if (count > dno->map_bcnt - bno)
+        count = dno->map_bcnt - bno;
+    if (idx < dno->run_count && count > dno->runs[idx].log_start - bno)
+        count = dno->runs[idx].log_start - bno;
+    extent->type = FSW_EXTENT_TYPE_SPARSE;
+    extent->log_count = count;
     return FSW_SUCCESS;
 }
 
@@ -383,15 +586,23 @@ static fsw_status_t fsw_ext2_dir_lookup(struct fsw_ext2_volume *vol, struct fsw_
     fsw_u32         child_ino;
     struct ext2_dir_entry entry;
     struct fsw_string entry_name;
+    struct fsw_string_key lookup_key;
 
     // Preconditions: The caller has checked that dno is a directory node.
 
     entry_name.type = FSW_STRING_TYPE_ISO88591;
 
+    // prepare the name for comparing it with many directory entries
+    status = fsw_strkey_init(&lookup_key, FSW_STRING_TYPE_ISO88591, lookup_name);
+    if (status)
+        return status;
+
     // setup handle to read the directory
     status = fsw_shandle_open(dno, &shand);
-    if (status)
+    if (status) {
+        fsw_strkey_free(&lookup_key);
         return status;
+    }
 
     // scan the directory for the file
     child_ino = 0;
@@ -409,7 +620,7 @@ static fsw_status_t fsw_ext2_dir_lookup(struct fsw_ext2_volume *vol, struct fsw_
         // compare name
         entry_name.len = entry_name.size = entry.name_len;
         entry_name.data = entry.name;
-        if (fsw_streq(lookup_name, &entry_name)) {
+        if (fsw_strkey_eq(&lookup_key, &entry_name)) {
             child_ino = entry.inode;
             break;
         }
@@ -420,6 +631,7 @@ static fsw_status_t fsw_ext2_dir_lookup(struct fsw_ext2_volume *vol, struct fsw_
 
 errorexit:
     fsw_shandle_close(&shand);
+    fsw_strkey_free(&lookup_key);
     return status;
 }
 
@@ -468,6 +680,93 @@ static fsw_status_t fsw_ext2_dir_read(struct fsw_ext2_volume *vol, struct fsw_ex
     return status;
 }
 
+/**
+ * Get up to max_count directory entries at once. This function is called by the core
+ * for fsw_dnode_dir_read_batch. Directory entries never cross a block boundary, so
+ * the rest of the current directory block is read with a single call and all entries
+ * in it are parsed in place, instead of reading each entry's header and name separately.
+ * The shandle's position is left at the first entry not returned.
+ */
+
+static fsw_status_t fsw_ext2_dir_read_batch(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                            struct fsw_shandle *shand, struct fsw_dir_record *records,
+                                            fsw_u32 max_count, fsw_u32 *count_out)
+{
+    fsw_status_t    status;
+    fsw_u8          *buffer;
+    fsw_u32         buffer_size, offset, count;
+    fsw_u64         block_pos;
+    int             end_of_dir;
+    struct ext2_dir_entry *entry;
+    struct fsw_string entry_name;
+    struct fsw_ext2_dnode *child_dno;
+
+    // Preconditions: The caller has checked that dno is a directory node. The caller
+    //  has opened a storage handle to the directory's storage and keeps it around between
+    //  calls.
+
+    status = fsw_alloc(vol->g.log_blocksize, &buffer);
+    if (status)
+        return status;
+
+    entry_name.type = FSW_STRING_TYPE_ISO88591;
+    count = 0;
+    end_of_dir = 0;
+    while (count < max_count && !end_of_dir) {
+        // read up to the end of the current directory block
+        block_pos = shand->pos;
+        buffer_size = vol->g.log_blocksize - ((fsw_u32)block_pos & (vol->g.log_blocksize - 1));
+        status = fsw_shandle_read(shand, &buffer_size, buffer);
+        if (status)
+            goto errorexit;
+        if (buffer_size < 8)
+            break;  // end of directory
+
+        for (offset = 0; offset + 8 <= buffer_size && count < max_count; offset += entry->rec_len) {
+            entry = (struct ext2_dir_entry *)(buffer + offset);
+            if (entry->rec_len == 0) {
+                end_of_dir = 1;
+                break;
+            }
+            if (entry->rec_len < 8) {
+                status = FSW_VOLUME_CORRUPTED;
+                goto errorexit;
+            }
+            if (entry->inode == 0)
+                continue;   // valid, but unused entry
+            if (entry->rec_len < 8 + entry->name_len || offset + 8 + entry->name_len > buffer_size) {
+                status = FSW_VOLUME_CORRUPTED;
+                goto errorexit;
+            }
+
+            // skip . and ..
+            if ((entry->name_len == 1 && entry->name[0] == '.') ||
+                (entry->name_len == 2 && entry->name[0] == '.' && entry->name[1] == '.'))
+                continue;
+
+            // setup a dnode for the child item
+            entry_name.len = entry_name.size = entry->name_len;
+            entry_name.data = entry->name;
+            status = fsw_dnode_create(dno, entry->inode, FSW_DNODE_TYPE_UNKNOWN, &entry_name, &child_dno);
+            if (status)
+                goto errorexit;
+            records[count++].dnode = &child_dno->g;
+        }
+        shand->pos = block_pos + offset;
+    }
+
+    fsw_free(buffer);
+    if (count == 0)
+        return FSW_NOT_FOUND;
+    *count_out = count;
+    return FSW_SUCCESS;
+
+errorexit:
+    fsw_dir_records_release(records, count);
+    fsw_free(buffer);
+    return status;
+}
+
 /**
  * Read a directory entry from the directory's raw data. This internal function is used
  * to read a raw ext2 directory entry into memory. The shandle's position pointer is adjusted
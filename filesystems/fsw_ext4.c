@@ -27,6 +27,7 @@
 
 // functions
 
+static fsw_status_t fsw_ext4_volume_probe(void *head, fsw_u32 head_size);
 static fsw_status_t fsw_ext4_volume_mount(struct fsw_ext4_volume *vol);
 static void         fsw_ext4_volume_free(struct fsw_ext4_volume *vol);
 static fsw_status_t fsw_ext4_volume_stat(struct fsw_ext4_volume *vol, struct fsw_volume_stat *sb);
@@ -44,8 +45,13 @@ static fsw_status_t fsw_ext4_get_by_extent(struct fsw_ext4_volume *vol, struct f
 
 static fsw_status_t fsw_ext4_dir_lookup(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
                                         struct fsw_string *lookup_name, struct fsw_ext4_dnode **child_dno);
+static fsw_status_t fsw_ext4_dx_lookup(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                       struct fsw_string_key *lookup_key, struct fsw_ext4_dnode **child_dno);
 static fsw_status_t fsw_ext4_dir_read(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
                                       struct fsw_shandle *shand, struct fsw_ext4_dnode **child_dno);
+static fsw_status_t fsw_ext4_dir_read_batch(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                            struct fsw_shandle *shand, struct fsw_dir_record *records,
+                                            fsw_u32 max_count, fsw_u32 *count_out);
 static fsw_status_t fsw_ext4_read_dentry(struct fsw_shandle *shand, struct ext4_dir_entry *entry);
 
 static fsw_status_t fsw_ext4_readlink(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
@@ -70,6 +76,9 @@ struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(ext4) = {
     fsw_ext4_dir_lookup,
     fsw_ext4_dir_read,
     fsw_ext4_readlink,
+    fsw_ext4_dir_read_batch,
+    EXT4_SUPERBLOCK_BLOCKNO * EXT4_SUPERBLOCK_BLOCKSIZE + sizeof(struct ext4_super_block),
+    fsw_ext4_volume_probe,
 };
 
 
@@ -100,6 +109,47 @@ fsw_ext4_group_first_block_no(struct ext4_super_block *sb, fsw_u32 group_no)
                 sb->s_first_data_block;
 }
 
+/**
+ * Check the superblock's magic number, revision, incompatible features
+ * and block size.
+ */
+
+static fsw_status_t fsw_ext4_check_superblock(struct ext4_super_block *sb)
+{
+    fsw_u32 blocksize;
+
+    if (sb->s_magic != EXT4_SUPER_MAGIC)
+        return FSW_UNSUPPORTED;
+    if (sb->s_rev_level != EXT4_GOOD_OLD_REV &&
+        sb->s_rev_level != EXT4_DYNAMIC_REV)
+        return FSW_UNSUPPORTED;
+    if (sb->s_rev_level == EXT4_DYNAMIC_REV &&
+        (sb->s_feature_incompat & ~(EXT4_FEATURE_INCOMPAT_FILETYPE | EXT4_FEATURE_INCOMPAT_RECOVER |
+                                    EXT4_FEATURE_INCOMPAT_EXTENTS | EXT4_FEATURE_INCOMPAT_FLEX_BG |
+                                    EXT4_FEATURE_INCOMPAT_META_BG)))
+        return FSW_UNSUPPORTED;
+
+    if (sb->s_log_block_size >= 32 - EXT4_MIN_BLOCK_LOG_SIZE)
+        return FSW_UNSUPPORTED;
+    blocksize = EXT4_BLOCK_SIZE(sb);
+    if (blocksize < EXT4_MIN_BLOCK_SIZE || blocksize > EXT4_MAX_BLOCK_SIZE)
+        return FSW_UNSUPPORTED;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Probe for an ext4 volume. Applies the mount time superblock checks to
+ * the superblock in the given head of the volume.
+ */
+
+static fsw_status_t fsw_ext4_volume_probe(void *head, fsw_u32 head_size)
+{
+    if (head_size < EXT4_SUPERBLOCK_BLOCKNO * EXT4_SUPERBLOCK_BLOCKSIZE + sizeof(struct ext4_super_block))
+        return FSW_UNSUPPORTED;
+    return fsw_ext4_check_superblock((struct ext4_super_block *)
+                                     ((fsw_u8 *)head + EXT4_SUPERBLOCK_BLOCKNO * EXT4_SUPERBLOCK_BLOCKSIZE));
+}
+
 /**
  * Mount an ext4 volume. Reads the superblock and constructs the
  * root directory dnode.
@@ -110,7 +160,7 @@ static fsw_status_t fsw_ext4_volume_mount(struct fsw_ext4_volume *vol)
     fsw_status_t    status;
     void            *buffer;
     fsw_u32         blocksize;
-    fsw_u32         groupcnt, groupno, gdesc_per_block, gdesc_bno, gdesc_index, metabg_of_gdesc;
+    fsw_u32         groupcnt, groupno, gdesc_per_block, gdesc_bno, gdesc_index, metabg_of_gdesc, gdesc_count;
     struct ext4_group_desc *gdesc;
     int             i;
     struct fsw_string s;
@@ -129,20 +179,11 @@ static fsw_status_t fsw_ext4_volume_mount(struct fsw_ext4_volume *vol)
     fsw_block_release(vol, EXT4_SUPERBLOCK_BLOCKNO, buffer);
 
     // check the superblock
-    if (vol->sb->s_magic != EXT4_SUPER_MAGIC)
-        return FSW_UNSUPPORTED;
-    if (vol->sb->s_rev_level != EXT4_GOOD_OLD_REV &&
-        vol->sb->s_rev_level != EXT4_DYNAMIC_REV)
-        return FSW_UNSUPPORTED;
-
     FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext4_volume_mount: Incompat flag %x\n"), vol->sb->s_feature_incompat));
 
-    if (vol->sb->s_rev_level == EXT4_DYNAMIC_REV &&
-        (vol->sb->s_feature_incompat & ~(EXT4_FEATURE_INCOMPAT_FILETYPE | EXT4_FEATURE_INCOMPAT_RECOVER |
-                                         EXT4_FEATURE_INCOMPAT_EXTENTS | EXT4_FEATURE_INCOMPAT_FLEX_BG |
-                                         EXT4_FEATURE_INCOMPAT_META_BG)))
-        return FSW_UNSUPPORTED;
-
+    status = fsw_ext4_check_superblock(vol->sb);
+    if (status)
+        return status;
 
     if (vol->sb->s_rev_level == EXT4_DYNAMIC_REV &&
         (vol->sb->s_feature_incompat & EXT4_FEATURE_INCOMPAT_RECOVER))
@@ -151,11 +192,8 @@ static fsw_status_t fsw_ext4_volume_mount(struct fsw_ext4_volume *vol)
         // Print(L"Ext4 WARNING: This file system needs recovery, trying to use it anyway.\n");
     }
 
-    blocksize = EXT4_BLOCK_SIZE(vol->sb);
-    if (blocksize < EXT4_MIN_BLOCK_SIZE || blocksize > EXT4_MAX_BLOCK_SIZE)
-        return FSW_UNSUPPORTED;
-
     // set real blocksize
+    blocksize = EXT4_BLOCK_SIZE(vol->sb);
     fsw_set_blocksize(vol, blocksize, blocksize);
 
     // get other info from superblock
@@ -192,6 +230,13 @@ static fsw_status_t fsw_ext4_volume_mount(struct fsw_ext4_volume *vol)
     if (status)
         return status;
 
+    // Descriptors outside of meta block groups follow the super block, read them in one go
+    gdesc_count = groupcnt;
+    if (vol->sb->s_feature_incompat & EXT4_FEATURE_INCOMPAT_META_BG && gdesc_count > vol->sb->s_first_meta_bg)
+        gdesc_count = vol->sb->s_first_meta_bg;
+    fsw_block_readahead(vol, vol->sb->s_first_data_block + 1,
+                        (gdesc_count + gdesc_per_block - 1) / gdesc_per_block, 1);
+
     // Loop through all block group descriptors in order to get inode table locations
     for (groupno = 0; groupno < groupcnt; groupno++) {
 
@@ -312,6 +357,20 @@ static fsw_status_t fsw_ext4_dnode_fill(struct fsw_ext4_volume *vol, struct fsw_
     return FSW_SUCCESS;
 }
 
+/**
+ * Free the block map of a dnode, so that it is decoded anew when needed next.
+ */
+
+static void fsw_ext4_map_free(struct fsw_ext4_dnode *dno)
+{
+    if (dno->runs)
+        fsw_free(dno->runs);
+    if (dno->map_done)
+        fsw_free(dno->map_done);
+    dno->runs = NULL;
+    dno->map_done = NULL;
+}
+
 /**
  * Free the dnode data structure. Called by the core when deallocating a dnode
  * structure to release the memory used by the file system type specific part
@@ -322,6 +381,7 @@ static void fsw_ext4_dnode_free(struct fsw_ext4_volume *vol, struct fsw_ext4_dno
 {
     if (dno->raw)
         fsw_free(dno->raw);
+    fsw_ext4_map_free(dno);
 }
 
 /**
@@ -379,162 +439,412 @@ static fsw_status_t fsw_ext4_get_extent(struct fsw_ext4_volume *vol, struct fsw_
 }
 
 /**
- * New ext4 extents...
+ * Return the number of runs in the block map that start at or before a logical
+ * block. This is the index of the run that follows the block.
+ */
+
+static fsw_u32 fsw_ext4_map_find(struct fsw_ext4_dnode *dno, fsw_u32 bno)
+{
+    fsw_u32         lo, hi, mid;
+
+    lo = 0;
+    hi = dno->run_count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (dno->runs[mid].log_start <= bno)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Append a run of blocks to the dnode's extent map. A run that continues the last
+ * one both logically and on disk is merged into it.
+ */
+
+static fsw_status_t fsw_ext4_add_run(struct fsw_ext4_dnode *dno, fsw_u32 log_start, fsw_u32 log_count,
+                                     fsw_u64 phys_start)
+{
+    fsw_status_t    status;
+    struct fsw_ext4_run *run, *new_runs;
+
+    if (dno->run_count > 0) {
+        run = &dno->runs[dno->run_count - 1];
+        if (log_start < run->log_start + run->log_count)
+            return FSW_VOLUME_CORRUPTED;    // extents must be sorted and must not overlap
+        if (log_start == run->log_start + run->log_count &&
+            phys_start == run->phys_start + run->log_count) {
+            run->log_count += log_count;
+            return FSW_SUCCESS;
+        }
+    }
+
+    if (dno->run_count == dno->run_alloc) {
+        status = fsw_alloc(2 * dno->run_alloc * sizeof(struct fsw_ext4_run), &new_runs);
+        if (status)
+            return status;
+        fsw_memcpy(new_runs, dno->runs, dno->run_count * sizeof(struct fsw_ext4_run));
+        fsw_free(dno->runs);
+        dno->runs = new_runs;
+        dno->run_alloc *= 2;
+    }
+    run = &dno->runs[dno->run_count++];
+    run->log_start = log_start;
+    run->log_count = log_count;
+    run->phys_start = phys_start;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Add the extents below a node of the extent tree to the dnode's extent map. The
+ * children of an index node are read in order, each released before the next one.
+ */
+
+static fsw_status_t fsw_ext4_map_extents(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                         struct ext4_extent_header *header, fsw_u32 max_entries, int depth)
+{
+    fsw_status_t    status;
+    struct ext4_extent *ext4_extent;
+    struct ext4_extent_idx *ext4_extent_idx;
+    void            *buffer;
+    fsw_u64         bno;
+    fsw_u32         len;
+    int             i, run_cnt;
+
+    if (header->eh_magic != EXT4_EXT_MAGIC || header->eh_entries > header->eh_max ||
+        header->eh_max > max_entries || header->eh_depth != depth)
+        return FSW_VOLUME_CORRUPTED;
+    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext4_map_extents: extent header with %d entries, depth %d\n"),
+                  header->eh_entries, header->eh_depth));
+
+    if (depth == 0) {
+        // leaf node, the header is followed by the actual extents
+        ext4_extent = (struct ext4_extent *)(header + 1);
+        for (i = 0; i < header->eh_entries; i++, ext4_extent++) {
+            // extents over EXT_INIT_MAX_LEN blocks are preallocated and read as zeros
+            len = ext4_extent->ee_len;
+            if (len > EXT_INIT_MAX_LEN)
+                continue;
+            status = fsw_ext4_add_run(dno, ext4_extent->ee_block, len,
+                                      FSW_U64_SHL((fsw_u64)ext4_extent->ee_start_hi, 32) | ext4_extent->ee_start_lo);
+            if (status)
+                return status;
+        }
+        return FSW_SUCCESS;
+    }
+
+    // index node, follow every child
+    ext4_extent_idx = (struct ext4_extent_idx *)(header + 1);
+    for (i = 0; i < header->eh_entries; ) {
+        // child blocks stored next to each other are read in one go
+        bno = FSW_U64_SHL((fsw_u64)ext4_extent_idx[i].ei_leaf_hi, 32) | ext4_extent_idx[i].ei_leaf_lo;
+        for (run_cnt = 1; i + run_cnt < header->eh_entries &&
+             ext4_extent_idx[i + run_cnt].ei_leaf_hi == ext4_extent_idx[i].ei_leaf_hi &&
+             ext4_extent_idx[i + run_cnt].ei_leaf_lo == ext4_extent_idx[i].ei_leaf_lo + run_cnt; run_cnt++)
+            ;
+        if (run_cnt > 1)
+            fsw_block_readahead(vol, bno, run_cnt, 1);
+
+        for (; run_cnt > 0; run_cnt--, i++, bno++) {
+            status = fsw_block_get(vol, bno, 1, &buffer);
+            if (status)
+                return status;
+            status = fsw_ext4_map_extents(vol, dno, (struct ext4_extent_header *)buffer,
+                                          (vol->g.log_blocksize - sizeof(struct ext4_extent_header)) /
+                                          sizeof(struct ext4_extent),
+                                          depth - 1);
+            fsw_block_release(vol, bno, buffer);
+            if (status)
+                return status;
+        }
+    }
+    return FSW_SUCCESS;
+}
+
+/**
+ * New ext4 extents. On first use, the whole extent tree is decoded into a sorted
+ * array of runs, with adjacent extents that are contiguous on disk merged. Each
+ * request is then a binary search in that array, without touching the tree again.
+ * Blocks between runs are holes or preallocated blocks and are returned as sparse.
  */
 static fsw_status_t fsw_ext4_get_by_extent(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
                                         struct fsw_extent *extent)
 {
     fsw_status_t  status;
-    fsw_u32       bno, buf_offset;
-    int           ext_cnt;
-    void          *buffer;
-
-    struct ext4_extent_header  *ext4_extent_header;
-    struct ext4_extent_idx     *ext4_extent_idx;
-    struct ext4_extent         *ext4_extent;
+    struct ext4_extent_header *header;
+    struct fsw_ext4_run *run;
+    fsw_u64       bno, file_bcnt;
+    fsw_u32       lo;
+
+    // decode the extent tree, its root is the i_block field of the inode
+    if (dno->runs == NULL) {
+        dno->run_count = 0;
+        dno->run_alloc = 4;
+        status = fsw_alloc(dno->run_alloc * sizeof(struct fsw_ext4_run), &dno->runs);
+        if (status)
+            return status;
+        header = (struct ext4_extent_header *)dno->raw->i_block;
+        if (header->eh_depth > EXT4_MAX_EXTENT_DEPTH)
+            status = FSW_VOLUME_CORRUPTED;
+        else
+            status = fsw_ext4_map_extents(vol, dno, header,
+                                          (sizeof(dno->raw->i_block) - sizeof(struct ext4_extent_header)) /
+                                          sizeof(struct ext4_extent),
+                                          header->eh_depth);
+        if (status) {
+            fsw_free(dno->runs);
+            dno->runs = NULL;
+            return status;
+        }
+    }
 
-    // Logical block requested by core...
+    // find the last run that starts at or before the requested block
     bno = extent->log_start;
+    lo = fsw_ext4_map_find(dno, (fsw_u32)bno);
 
-    // First buffer is the i_block field from inode...
-    buffer = (void *)dno->raw->i_block;
-    buf_offset = 0;
-    while(1) {
-        ext4_extent_header = (struct ext4_extent_header *)((char *)buffer + buf_offset);
-        buf_offset += sizeof(struct ext4_extent_header);
-        FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext4_get_by_extent: extent header with %d entries\n"), 
-                      ext4_extent_header->eh_entries));
-        if(ext4_extent_header->eh_magic != EXT4_EXT_MAGIC)
-            return FSW_VOLUME_CORRUPTED;
+    if (lo > 0) {
+        run = &dno->runs[lo - 1];
+        if (bno < (fsw_u64)run->log_start + run->log_count) {
+            extent->phys_start = run->phys_start + (bno - run->log_start);
+            extent->log_count = run->log_start + run->log_count - (fsw_u32)bno;
+            return FSW_SUCCESS;
+        }
+    }
 
-        for(ext_cnt = 0;ext_cnt < ext4_extent_header->eh_entries;ext_cnt++)
-        {
-            if(ext4_extent_header->eh_depth == 0)
-            {
-                // Leaf node, the header follows actual extents
-                ext4_extent = (struct ext4_extent *)((char *)buffer + buf_offset);
-                buf_offset += sizeof(struct ext4_extent);
-                FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext4_get_by_extent: extent node cover %d...\n"), ext4_extent->ee_block));
-
-                // Is the requested block in this extent?
-                if(bno >= ext4_extent->ee_block && bno < ext4_extent->ee_block + ext4_extent->ee_len)
-                {
-                    extent->phys_start = ext4_extent->ee_start_lo + (bno - ext4_extent->ee_block);
-                    extent->log_count = ext4_extent->ee_len - (bno - ext4_extent->ee_block);
-                    return FSW_SUCCESS;
-                }
-            }
-            else
-            {
-                FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext4_get_by_extent: index extents, depth %d\n"), 
-                          ext4_extent_header->eh_depth));
-                ext4_extent_idx = (struct ext4_extent_idx *)((char *)buffer + buf_offset);
-                buf_offset += sizeof(struct ext4_extent_idx);
-
-                FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext4_get_by_extent: index node covers block %d...\n"),
-                          ext4_extent_idx->ei_block));
-                if(bno >= ext4_extent_idx->ei_block)
-                {
-                    // Follow extent tree...
-                    status = fsw_block_get(vol, ext4_extent_idx->ei_leaf_lo, 1, (void **)&buffer);
-                    if (status)
-                        return status;
-                    buf_offset = 0;
-                    break;
-                }
-            }
+    // a hole, up to the next run or the end of the file
+    extent->type = FSW_EXTENT_TYPE_SPARSE;
+    if (lo < dno->run_count) {
+        extent->log_count = dno->runs[lo].log_start - (fsw_u32)bno;
+    } else {
+        file_bcnt = FSW_U64_DIV(dno->g.size + vol->g.log_blocksize - 1, vol->g.log_blocksize);
+        extent->log_count = bno < file_bcnt ? (fsw_u32)(file_bcnt - bno) : 1;
+    }
+    return FSW_SUCCESS;
+}
+
+/**
+ * Return the block map chunk a logical block belongs to. Chunk 0 holds the direct
+ * block pointers in the inode, every further chunk holds the block pointers of one
+ * indirect block, in file order.
+ */
+
+static fsw_u32 fsw_ext4_map_chunk_of(struct fsw_ext4_volume *vol, fsw_u32 bno)
+{
+    if (bno < EXT4_NDIR_BLOCKS)
+        return 0;
+    return 1 + (bno - EXT4_NDIR_BLOCKS) / vol->ind_bcnt;
+}
+
+/**
+ * Add one mapped block to the block map, at the index where the runs of its chunk
+ * are being inserted. The block extends the run before it if it continues that run
+ * on disk, otherwise it starts a new run. A run that meets the one after it is
+ * merged with it.
+ */
+
+static fsw_status_t fsw_ext4_map_add_block(struct fsw_ext4_dnode *dno, fsw_u32 *pos,
+                                           fsw_u32 log_bno, fsw_u32 phys_bno)
+{
+    fsw_status_t    status;
+    struct fsw_ext4_run *run, *new_runs;
+    fsw_u32         i;
+
+    run = (*pos > 0) ? &dno->runs[*pos - 1] : NULL;
+    if (run != NULL && run->log_start + run->log_count == log_bno &&
+        run->phys_start + run->log_count == phys_bno) {
+        run->log_count++;
+    } else {
+        if (dno->run_count == dno->run_alloc) {
+            status = fsw_alloc(2 * dno->run_alloc * sizeof(struct fsw_ext4_run), &new_runs);
+            if (status)
+                return status;
+            fsw_memcpy(new_runs, dno->runs, dno->run_count * sizeof(struct fsw_ext4_run));
+            fsw_free(dno->runs);
+            dno->runs = new_runs;
+            dno->run_alloc *= 2;
         }
+        for (i = dno->run_count; i > *pos; i--)
+            dno->runs[i] = dno->runs[i - 1];
+        dno->run_count++;
+        run = &dno->runs[(*pos)++];
+        run->log_start = log_bno;
+        run->log_count = 1;
+        run->phys_start = phys_bno;
     }
 
-    return FSW_NOT_FOUND;
+    // merge with the following run
+    if (*pos < dno->run_count &&
+        run->log_start + run->log_count == run[1].log_start &&
+        run->phys_start + run->log_count == run[1].phys_start) {
+        run->log_count += run[1].log_count;
+        dno->run_count--;
+        for (i = *pos; i < dno->run_count; i++)
+            dno->runs[i] = dno->runs[i + 1];
+    }
+    return FSW_SUCCESS;
 }
 
 /**
- * The ext2/ext3 file system does not use extents, but stores a list of block numbers
- * using the usual direct, indirect, double-indirect, triple-indirect scheme. To
- * optimize access, this function checks if the following file blocks are mapped
- * to consecutive disk blocks and returns a combined extent if possible.
+ * Decode one chunk of block pointers into the block map. For an indirect chunk,
+ * this walks down from the inode to the indirect block that holds the pointers.
+ * A missing indirect block anywhere on the way leaves the whole chunk a hole.
  */
-static fsw_status_t fsw_ext4_get_by_blkaddr(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
-                                        struct fsw_extent *extent)
+
+static fsw_status_t fsw_ext4_map_chunk(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                       fsw_u32 chunk)
 {
     fsw_status_t    status;
-    fsw_u32         bno, release_bno, buf_bcnt, file_bcnt;
-    int             path[5], i;
+    fsw_u32         log_start, count, ind, bno, release_bno, pos, i;
     fsw_u32         *buffer;
-    bno = extent->log_start;
+    int             path[4], level;
 
-    // try direct block pointers in the inode
-    if (bno < EXT4_NDIR_BLOCKS) {
-        path[0] = bno;
-        path[1] = -1;
+    // find the indirect block that holds the chunk
+    if (chunk == 0) {
+        log_start = 0;
+        count = EXT4_NDIR_BLOCKS;
+        path[0] = -1;
     } else {
-        bno -= EXT4_NDIR_BLOCKS;
-
-        // try indirect block
-        if (bno < vol->ind_bcnt) {
+        ind = chunk - 1;
+        log_start = EXT4_NDIR_BLOCKS + ind * vol->ind_bcnt;
+        count = vol->ind_bcnt;
+        if (ind == 0) {
             path[0] = EXT4_IND_BLOCK;
-            path[1] = bno;
-            path[2] = -1;
+            path[1] = -1;
         } else {
-            bno -= vol->ind_bcnt;
-
-            // try double-indirect block
-            if (bno < vol->dind_bcnt) {
+            ind -= 1;
+            if (ind < vol->ind_bcnt) {
                 path[0] = EXT4_DIND_BLOCK;
-                path[1] = bno / vol->ind_bcnt;
-                path[2] = bno % vol->ind_bcnt;
-                path[3] = -1;
+                path[1] = ind;
+                path[2] = -1;
             } else {
-                bno -= vol->dind_bcnt;
-
-                // use the triple-indirect block
+                ind -= vol->ind_bcnt;
+                if (ind / vol->ind_bcnt >= vol->ind_bcnt)
+                    return FSW_VOLUME_CORRUPTED;    // beyond the reach of the triple-indirect block
                 path[0] = EXT4_TIND_BLOCK;
-                path[1] = bno / vol->dind_bcnt;
-                path[2] = (bno / vol->ind_bcnt) % vol->ind_bcnt;
-                path[3] = bno % vol->ind_bcnt;
-                path[4] = -1;
+                path[1] = ind / vol->ind_bcnt;
+                path[2] = ind % vol->ind_bcnt;
+                path[3] = -1;
             }
         }
     }
-    
+    if (count > dno->map_bcnt - log_start)
+        count = dno->map_bcnt - log_start;
+
     // follow the indirection path
     buffer = dno->raw->i_block;
-    buf_bcnt = EXT4_NDIR_BLOCKS;
     release_bno = 0;
-    for (i = 0; ; i++) {
-        bno = buffer[path[i]];
-        if (bno == 0) {
-            extent->type = FSW_EXTENT_TYPE_SPARSE;
-            if (release_bno)
-                fsw_block_release(vol, release_bno, buffer);
-            return FSW_SUCCESS;
-        }
-        if (path[i+1] < 0)
-            break;
-
+    for (level = 0; path[level] >= 0; level++) {
+        bno = buffer[path[level]];
         if (release_bno)
             fsw_block_release(vol, release_bno, buffer);
+        release_bno = 0;
+        if (bno == 0)
+            break;
         status = fsw_block_get(vol, bno, 1, (void **)&buffer);
         if (status)
             return status;
         release_bno = bno;
-        buf_bcnt = vol->ind_bcnt;
     }
-    extent->phys_start = bno;
 
-    // check if the following blocks can be aggregated into one extent
-    file_bcnt = (fsw_u32)((dno->g.size + vol->g.log_blocksize - 1) & (vol->g.log_blocksize - 1));
-    while (path[i]           + extent->log_count < buf_bcnt &&    // indirect block has more block pointers
-           extent->log_start + extent->log_count < file_bcnt) {   // file has more blocks
-        if (buffer[path[i] + extent->log_count] == buffer[path[i] + extent->log_count - 1] + 1)
-            extent->log_count++;
-        else
-            break;
+    // the runs of the chunk go before all runs of later chunks
+    status = FSW_SUCCESS;
+    if (path[level] < 0) {
+        pos = fsw_ext4_map_find(dno, log_start);
+        for (i = 0; i < count && status == FSW_SUCCESS; i++) {
+            if (buffer[i])
+                status = fsw_ext4_map_add_block(dno, &pos, log_start + i, buffer[i]);
+        }
+        if (release_bno)
+            fsw_block_release(vol, release_bno, buffer);
+    }
+    if (status == FSW_SUCCESS)
+        dno->map_done[chunk >> 3] |= 1 << (chunk & 7);
+    return status;
+}
+
+/**
+ * The ext2/ext3 file system does not use extents, but stores a list of block numbers
+ * using the usual direct, indirect, double-indirect, triple-indirect scheme. These
+ * are decoded into the dnode's block map, one indirect block at a time as the file
+ * is read. A run that reaches the end of an indirect block pulls in the next one, so
+ * that a file stored in one piece comes back as one extent. Reading the same part
+ * of the file again needs no metadata.
+ */
+static fsw_status_t fsw_ext4_get_by_blkaddr(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                        struct fsw_extent *extent)
+{
+    fsw_status_t    status;
+    fsw_u32         bno, chunk, idx, run_end, count;
+    fsw_u64         file_bcnt;
+    struct fsw_ext4_run *run;
+
+    if (dno->runs == NULL) {
+        file_bcnt = FSW_U64_DIV(dno->g.size + vol->g.log_blocksize - 1, vol->g.log_blocksize);
+        dno->map_bcnt = (file_bcnt > 0xffffffffUL) ? 0xffffffffUL : (fsw_u32)file_bcnt;
+        dno->run_count = 0;
+        dno->run_alloc = 4;
+        status = fsw_alloc(dno->run_alloc * sizeof(struct fsw_ext4_run), &dno->runs);
+        if (status)
+            return status;
+        chunk = (dno->map_bcnt > 0) ? fsw_ext4_map_chunk_of(vol, dno->map_bcnt - 1) : 0;
+        status = fsw_alloc_zero(chunk / 8 + 1, (void **)&dno->map_done);
+        if (status) {
+            fsw_ext4_map_free(dno);
+            return status;
+        }
     }
 
-    if (release_bno)
-        fsw_block_release(vol, release_bno, buffer);
+    bno = extent->log_start;
+    if (bno >= dno->map_bcnt)
+        return FSW_VOLUME_CORRUPTED;
+    chunk = fsw_ext4_map_chunk_of(vol, bno);
+    if (!(dno->map_done[chunk >> 3] & (1 << (chunk & 7)))) {
+        status = fsw_ext4_map_chunk(vol, dno, chunk);
+        if (status) {
+            fsw_ext4_map_free(dno);
+            return status;
+        }
+    }
+
+    idx = fsw_ext4_map_find(dno, bno);
+    if (idx > 0 && bno - dno->runs[idx - 1].log_start < dno->runs[idx - 1].log_count) {
+        // a run that ends with its chunk may go on in the next one
+        idx--;
+        run_end = dno->runs[idx].log_start + dno->runs[idx].log_count;
+        while (run_end < dno->map_bcnt) {
+            chunk = fsw_ext4_map_chunk_of(vol, run_end);
+            if (dno->map_done[chunk >> 3] & (1 << (chunk & 7)))
+                break;
+            status = fsw_ext4_map_chunk(vol, dno, chunk);
+            if (status) {
+                fsw_ext4_map_free(dno);
+                return status;
+            }
+            if (dno->runs[idx].log_start + dno->runs[idx].log_count == run_end)
+                break;
+            run_end = dno->runs[idx].log_start + dno->runs[idx].log_count;
+        }
+
+        run = &dno->runs[idx];
+        extent->type = FSW_EXTENT_TYPE_PHYSBLOCK;
+        extent->phys_start = run->phys_start + (bno - run->log_start);
+        extent->log_count = run->log_start + run->log_count - bno;
+        return FSW_SUCCESS;
+    }
+
+    // a hole, up to the next run or the end of the chunk
+    if (chunk == 0)
+        count = EXT4_NDIR_BLOCKS - bno;
+    else
+        count = vol->ind_bcnt - (bno - EXT4_NDIR_BLOCKS) % vol->ind_bcnt;
+    if (count > dno->map_bcnt - bno)
+        count = dno->map_bcnt - bno;
+    if (idx < dno->run_count && count > dno->runs[idx].log_start - bno)
+        count = dno->runs[idx].log_start - bno;
+    extent->type = FSW_EXTENT_TYPE_SPARSE;
+    extent->log_count = count;
     return FSW_SUCCESS;
 }
 
@@ -553,15 +863,33 @@ static fsw_status_t fsw_ext4_dir_lookup(struct fsw_ext4_volume *vol, struct fsw_
     fsw_u32         child_ino;
     struct ext4_dir_entry entry;
     struct fsw_string entry_name;
+    struct fsw_string_key lookup_key;
 
     // Preconditions: The caller has checked that dno is a directory node.
 
     entry_name.type = FSW_STRING_TYPE_ISO88591;
 
+    // prepare the name for comparing it with many directory entries
+    status = fsw_strkey_init(&lookup_key, FSW_STRING_TYPE_ISO88591, lookup_name);
+    if (status)
+        return status;
+
+    // a hash-indexed directory only needs the leaf block the name hashes to
+    if ((dno->raw->i_flags & EXT4_INDEX_FL) &&
+        (vol->sb->s_feature_compat & EXT4_FEATURE_COMPAT_DIR_INDEX)) {
+        status = fsw_ext4_dx_lookup(vol, dno, &lookup_key, child_dno_out);
+        if (status != FSW_UNSUPPORTED) {
+            fsw_strkey_free(&lookup_key);
+            return status;
+        }
+    }
+
     // setup handle to read the directory
     status = fsw_shandle_open(dno, &shand);
-    if (status)
+    if (status) {
+        fsw_strkey_free(&lookup_key);
         return status;
+    }
 
     // scan the directory for the file
     child_ino = 0;
@@ -579,7 +907,7 @@ static fsw_status_t fsw_ext4_dir_lookup(struct fsw_ext4_volume *vol, struct fsw_
         // compare name
         entry_name.len = entry_name.size = entry.name_len;
         entry_name.data = entry.name;
-        if (fsw_streq(lookup_name, &entry_name)) {
+        if (fsw_strkey_eq(&lookup_key, &entry_name)) {
             child_ino = entry.inode;
             break;
         }
@@ -590,6 +918,377 @@ static fsw_status_t fsw_ext4_dir_lookup(struct fsw_ext4_volume *vol, struct fsw_
 
 errorexit:
     fsw_shandle_close(&shand);
+    fsw_strkey_free(&lookup_key);
+    return status;
+}
+
+/*
+ * Directory hash functions, as in the Linux kernel's fs/ext4/hash.c.
+ */
+
+#define DX_ROL32(x, s)      (((x) << (s)) | ((x) >> (32 - (s))))
+
+#define DX_F(x, y, z)       ((z) ^ ((x) & ((y) ^ (z))))
+#define DX_G(x, y, z)       (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define DX_H(x, y, z)       ((x) ^ (y) ^ (z))
+#define DX_ROUND(f, a, b, c, d, x, s) \
+    (a += f(b, c, d) + (x), a = DX_ROL32(a, s))
+#define DX_K2               0x5A827999
+#define DX_K3               0x6ED9EBA1
+
+static void fsw_ext4_dx_half_md4(fsw_u32 buf[4], fsw_u32 in[8])
+{
+    fsw_u32 a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+    DX_ROUND(DX_F, a, b, c, d, in[0],  3);
+    DX_ROUND(DX_F, d, a, b, c, in[1],  7);
+    DX_ROUND(DX_F, c, d, a, b, in[2], 11);
+    DX_ROUND(DX_F, b, c, d, a, in[3], 19);
+    DX_ROUND(DX_F, a, b, c, d, in[4],  3);
+    DX_ROUND(DX_F, d, a, b, c, in[5],  7);
+    DX_ROUND(DX_F, c, d, a, b, in[6], 11);
+    DX_ROUND(DX_F, b, c, d, a, in[7], 19);
+
+    DX_ROUND(DX_G, a, b, c, d, in[1] + DX_K2,  3);
+    DX_ROUND(DX_G, d, a, b, c, in[3] + DX_K2,  5);
+    DX_ROUND(DX_G, c, d, a, b, in[5] + DX_K2,  9);
+    DX_ROUND(DX_G, b, c, d, a, in[7] + DX_K2, 13);
+    DX_ROUND(DX_G, a, b, c, d, in[0] + DX_K2,  3);
+    DX_ROUND(DX_G, d, a, b, c, in[2] + DX_K2,  5);
+    DX_ROUND(DX_G, c, d, a, b, in[4] + DX_K2,  9);
+    DX_ROUND(DX_G, b, c, d, a, in[6] + DX_K2, 13);
+
+    DX_ROUND(DX_H, a, b, c, d, in[3] + DX_K3,  3);
+    DX_ROUND(DX_H, d, a, b, c, in[7] + DX_K3,  9);
+    DX_ROUND(DX_H, c, d, a, b, in[2] + DX_K3, 11);
+    DX_ROUND(DX_H, b, c, d, a, in[6] + DX_K3, 15);
+    DX_ROUND(DX_H, a, b, c, d, in[1] + DX_K3,  3);
+    DX_ROUND(DX_H, d, a, b, c, in[5] + DX_K3,  9);
+    DX_ROUND(DX_H, c, d, a, b, in[0] + DX_K3, 11);
+    DX_ROUND(DX_H, b, c, d, a, in[4] + DX_K3, 15);
+
+    buf[0] += a;
+    buf[1] += b;
+    buf[2] += c;
+    buf[3] += d;
+}
+
+static void fsw_ext4_dx_tea(fsw_u32 buf[4], fsw_u32 in[4])
+{
+    fsw_u32 sum = 0;
+    fsw_u32 b0 = buf[0], b1 = buf[1];
+    fsw_u32 a = in[0], b = in[1], c = in[2], d = in[3];
+    int     n = 16;
+
+    do {
+        sum += 0x9E3779B9;
+        b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+        b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+    } while (--n);
+
+    buf[0] += b0;
+    buf[1] += b1;
+}
+
+/**
+ * Get the character at a position of a name, sign extended for the signed hash variants.
+ */
+
+static __inline fsw_u32 fsw_ext4_dx_char(const fsw_u8 *name, int i, int is_unsigned)
+{
+    if (is_unsigned || name[i] < 0x80)
+        return name[i];
+    return name[i] | 0xffffff00;
+}
+
+static fsw_u32 fsw_ext4_dx_legacy(const fsw_u8 *name, int len, int is_unsigned)
+{
+    fsw_u32 hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+    int     i;
+
+    for (i = 0; i < len; i++) {
+        hash = hash1 + (hash0 ^ (fsw_ext4_dx_char(name, i, is_unsigned) * 7152373));
+        if (hash & 0x80000000)
+            hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+static void fsw_ext4_dx_str2hashbuf(const fsw_u8 *name, int len, fsw_u32 *buf, int num, int is_unsigned)
+{
+    fsw_u32 pad, val;
+    int     i;
+
+    pad = (fsw_u32)len | ((fsw_u32)len << 8);
+    pad |= pad << 16;
+
+    val = pad;
+    if (len > num * 4)
+        len = num * 4;
+    for (i = 0; i < len; i++) {
+        val = fsw_ext4_dx_char(name, i, is_unsigned) + (val << 8);
+        if ((i % 4) == 3) {
+            *buf++ = val;
+            val = pad;
+            num--;
+        }
+    }
+    if (--num >= 0)
+        *buf++ = val;
+    while (--num >= 0)
+        *buf++ = pad;
+}
+
+/**
+ * Compute the major hash of a file name for the given hash version. Returns
+ * FSW_UNSUPPORTED for hash versions this driver does not know.
+ */
+
+static fsw_status_t fsw_ext4_dx_hash(struct fsw_ext4_volume *vol, int hash_version,
+                                     const fsw_u8 *name, int len, fsw_u32 *hash_out)
+{
+    fsw_u32         buf[4], in[8], hash;
+    int             i, is_unsigned;
+
+    buf[0] = 0x67452301;
+    buf[1] = 0xefcdab89;
+    buf[2] = 0x98badcfe;
+    buf[3] = 0x10325476;
+    for (i = 0; i < 4; i++) {
+        if (vol->sb->s_hash_seed[i] != 0) {
+            fsw_memcpy(buf, vol->sb->s_hash_seed, sizeof(buf));
+            break;
+        }
+    }
+
+    is_unsigned = hash_version >= DX_HASH_LEGACY_UNSIGNED;
+    switch (hash_version) {
+    case DX_HASH_LEGACY:
+    case DX_HASH_LEGACY_UNSIGNED:
+        hash = fsw_ext4_dx_legacy(name, len, is_unsigned);
+        break;
+    case DX_HASH_HALF_MD4:
+    case DX_HASH_HALF_MD4_UNSIGNED:
+        for (; len > 0; len -= 32, name += 32) {
+            fsw_ext4_dx_str2hashbuf(name, len, in, 8, is_unsigned);
+            fsw_ext4_dx_half_md4(buf, in);
+        }
+        hash = buf[1];
+        break;
+    case DX_HASH_TEA:
+    case DX_HASH_TEA_UNSIGNED:
+        for (; len > 0; len -= 16, name += 16) {
+            fsw_ext4_dx_str2hashbuf(name, len, in, 4, is_unsigned);
+            fsw_ext4_dx_tea(buf, in);
+        }
+        hash = buf[0];
+        break;
+    default:
+        return FSW_UNSUPPORTED;
+    }
+
+    hash &= ~1;
+    if (hash == (EXT4_HTREE_EOF_32BIT << 1))
+        hash = (EXT4_HTREE_EOF_32BIT - 1) << 1;
+    *hash_out = hash;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Read a block of a directory into the buffer. A block outside the directory
+ * means the index is not usable.
+ */
+
+static fsw_status_t fsw_ext4_dx_read_block(struct fsw_ext4_volume *vol, struct fsw_shandle *shand,
+                                           fsw_u32 block, fsw_u8 *buffer)
+{
+    fsw_status_t    status;
+    fsw_u32         buffer_size;
+
+    shand->pos = (fsw_u64)block * vol->g.log_blocksize;
+    if (shand->pos >= shand->dnode->size)
+        return FSW_UNSUPPORTED;
+    buffer_size = vol->g.log_blocksize;
+    status = fsw_shandle_read(shand, &buffer_size, buffer);
+    if (status)
+        return status;
+    if (buffer_size < vol->g.log_blocksize)
+        return FSW_UNSUPPORTED;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Check the count and limit at the start of a dx_entry array that begins at the
+ * given offset into its block. Returns the number of entries, or 0 if they are not sane.
+ */
+
+static fsw_u32 fsw_ext4_dx_count(struct fsw_ext4_volume *vol, struct dx_entry *entries, fsw_u32 offset)
+{
+    struct dx_countlimit *countlimit = (struct dx_countlimit *)entries;
+
+    if (countlimit->count == 0 || countlimit->count > countlimit->limit ||
+        countlimit->limit > (vol->g.log_blocksize - offset) / sizeof(struct dx_entry))
+        return 0;
+    return countlimit->count;
+}
+
+/**
+ * Look for a name in one leaf block of a hash-indexed directory.
+ */
+
+static fsw_status_t fsw_ext4_dx_scan_leaf(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                          fsw_u8 *buffer, struct fsw_string_key *lookup_key,
+                                          struct fsw_ext4_dnode **child_dno_out)
+{
+    fsw_u32         offset;
+    struct ext4_dir_entry *entry;
+    struct fsw_string entry_name;
+
+    entry_name.type = FSW_STRING_TYPE_ISO88591;
+    for (offset = 0; offset + 8 <= vol->g.log_blocksize; offset += entry->rec_len) {
+        entry = (struct ext4_dir_entry *)(buffer + offset);
+        if (entry->rec_len < 8)
+            return FSW_VOLUME_CORRUPTED;
+        if (entry->inode == 0)
+            continue;   // valid, but unused entry
+        if (entry->rec_len < 8 + entry->name_len || offset + 8 + entry->name_len > vol->g.log_blocksize)
+            return FSW_VOLUME_CORRUPTED;
+
+        entry_name.len = entry_name.size = entry->name_len;
+        entry_name.data = entry->name;
+        if (fsw_strkey_eq(lookup_key, &entry_name))
+            return fsw_dnode_create(dno, entry->inode, FSW_DNODE_TYPE_UNKNOWN, &entry_name, child_dno_out);
+    }
+    return FSW_NOT_FOUND;
+}
+
+/**
+ * Lookup a directory's child dnode by name through the directory's hash tree. The
+ * name's hash selects one entry on each level of the index, down to the leaf block
+ * that holds the name if it exists. Names whose hashes collide can continue into the
+ * following leaf blocks, which the index marks by repeating the hash.
+ *
+ * Returns FSW_UNSUPPORTED if the index cannot be used, e.g. for an unknown hash
+ * version or inconsistent index blocks. The caller then scans the directory linearly,
+ * which does not depend on the index.
+ */
+
+static fsw_status_t fsw_ext4_dx_lookup(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                       struct fsw_string_key *lookup_key, struct fsw_ext4_dnode **child_dno_out)
+{
+    fsw_status_t    status;
+    struct fsw_shandle shand;
+    fsw_u8          *buffer;
+    struct dx_root_info *info;
+    struct dx_entry *entries[EXT4_HTREE_LEVEL];
+    fsw_u32         count[EXT4_HTREE_LEVEL], at[EXT4_HTREE_LEVEL];
+    fsw_u32         hash, block, p, q, m;
+    int             hash_version, levels, level;
+
+    // names with characters outside ISO 8859-1 are not in the directory at all
+    if (lookup_key->nomatch)
+        return FSW_NOT_FOUND;
+    if (lookup_key->str.type != FSW_STRING_TYPE_ISO88591)
+        return FSW_UNSUPPORTED;
+
+    // one buffer per index level and one for the leaf block
+    status = fsw_alloc((EXT4_HTREE_LEVEL + 1) * vol->g.log_blocksize, &buffer);
+    if (status)
+        return status;
+    status = fsw_shandle_open(dno, &shand);
+    if (status) {
+        fsw_free(buffer);
+        return status;
+    }
+
+    // the root in block 0 tells the hash version and depth
+    status = fsw_ext4_dx_read_block(vol, &shand, 0, buffer);
+    if (status)
+        goto errorexit;
+    info = (struct dx_root_info *)(buffer + EXT4_DX_ROOT_INFO_OFFSET);
+    if (info->reserved_zero != 0 || info->info_length != sizeof(struct dx_root_info) ||
+        info->indirect_levels >= EXT4_HTREE_LEVEL) {
+        status = FSW_UNSUPPORTED;
+        goto errorexit;
+    }
+    levels = info->indirect_levels;
+    hash_version = info->hash_version;
+    if (hash_version <= DX_HASH_TEA && (vol->sb->s_flags & EXT2_FLAGS_UNSIGNED_HASH))
+        hash_version += DX_HASH_LEGACY_UNSIGNED;
+    status = fsw_ext4_dx_hash(vol, hash_version, lookup_key->str.data, lookup_key->str.len, &hash);
+    if (status)
+        goto errorexit;
+
+    entries[0] = (struct dx_entry *)(buffer + EXT4_DX_ROOT_INFO_OFFSET + info->info_length);
+    count[0] = fsw_ext4_dx_count(vol, entries[0], EXT4_DX_ROOT_INFO_OFFSET + info->info_length);
+    for (level = 0; ; level++) {
+        if (count[level] == 0) {
+            status = FSW_UNSUPPORTED;
+            goto errorexit;
+        }
+
+        // find the last entry whose hash is not above the name's hash; entry 0 covers all lower hashes
+        p = 1;
+        q = count[level] - 1;
+        while (p <= q) {
+            m = p + (q - p) / 2;
+            if (entries[level][m].hash > hash)
+                q = m - 1;
+            else
+                p = m + 1;
+        }
+        at[level] = p - 1;
+        block = entries[level][at[level]].block & 0x0fffffff;
+        if (level == levels)
+            break;
+
+        status = fsw_ext4_dx_read_block(vol, &shand, block, buffer + (level + 1) * vol->g.log_blocksize);
+        if (status)
+            goto errorexit;
+        entries[level + 1] = (struct dx_entry *)(buffer + (level + 1) * vol->g.log_blocksize +
+                                                 EXT4_DX_NODE_ENTRIES_OFFSET);
+        count[level + 1] = fsw_ext4_dx_count(vol, entries[level + 1], EXT4_DX_NODE_ENTRIES_OFFSET);
+    }
+
+    while (1) {
+        status = fsw_ext4_dx_read_block(vol, &shand, block, buffer + EXT4_HTREE_LEVEL * vol->g.log_blocksize);
+        if (status)
+            goto errorexit;
+        status = fsw_ext4_dx_scan_leaf(vol, dno, buffer + EXT4_HTREE_LEVEL * vol->g.log_blocksize,
+                                       lookup_key, child_dno_out);
+        if (status != FSW_NOT_FOUND)
+            goto errorexit;
+
+        // go on with the next leaf only if it starts with the same hash
+        for (level = levels; at[level] + 1 >= count[level]; level--) {
+            if (level == 0)
+                goto errorexit;
+        }
+        at[level]++;
+        if ((entries[level][at[level]].hash & ~1) != hash)
+            goto errorexit;
+        block = entries[level][at[level]].block & 0x0fffffff;
+        for (; level < levels; level++) {
+            status = fsw_ext4_dx_read_block(vol, &shand, block, buffer + (level + 1) * vol->g.log_blocksize);
+            if (status)
+                goto errorexit;
+            entries[level + 1] = (struct dx_entry *)(buffer + (level + 1) * vol->g.log_blocksize +
+                                                     EXT4_DX_NODE_ENTRIES_OFFSET);
+            count[level + 1] = fsw_ext4_dx_count(vol, entries[level + 1], EXT4_DX_NODE_ENTRIES_OFFSET);
+            if (count[level + 1] == 0) {
+                status = FSW_UNSUPPORTED;
+                goto errorexit;
+            }
+            at[level + 1] = 0;
+            block = entries[level + 1][0].block & 0x0fffffff;
+        }
+    }
+
+errorexit:
+    fsw_shandle_close(&shand);
+    fsw_free(buffer);
     return status;
 }
 
@@ -639,6 +1338,93 @@ static fsw_status_t fsw_ext4_dir_read(struct fsw_ext4_volume *vol, struct fsw_ex
     return status;
 }
 
+/**
+ * Get up to max_count directory entries at once. This function is called by the core
+ * for fsw_dnode_dir_read_batch. Directory entries never cross a block boundary, so
+ * the rest of the current directory block is read with a single call and all entries
+ * in it are parsed in place, instead of reading each entry's header and name separately.
+ * The shandle's position is left at the first entry not returned.
+ */
+
+static fsw_status_t fsw_ext4_dir_read_batch(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                            struct fsw_shandle *shand, struct fsw_dir_record *records,
+                                            fsw_u32 max_count, fsw_u32 *count_out)
+{
+    fsw_status_t    status;
+    fsw_u8          *buffer;
+    fsw_u32         buffer_size, offset, count;
+    fsw_u64         block_pos;
+    int             end_of_dir;
+    struct ext4_dir_entry *entry;
+    struct fsw_string entry_name;
+    struct fsw_ext4_dnode *child_dno;
+
+    // Preconditions: The caller has checked that dno is a directory node. The caller
+    //  has opened a storage handle to the directory's storage and keeps it around between
+    //  calls.
+
+    status = fsw_alloc(vol->g.log_blocksize, &buffer);
+    if (status)
+        return status;
+
+    entry_name.type = FSW_STRING_TYPE_ISO88591;
+    count = 0;
+    end_of_dir = 0;
+    while (count < max_count && !end_of_dir) {
+        // read up to the end of the current directory block
+        block_pos = shand->pos;
+        buffer_size = vol->g.log_blocksize - ((fsw_u32)block_pos & (vol->g.log_blocksize - 1));
+        status = fsw_shandle_read(shand, &buffer_size, buffer);
+        if (status)
+            goto errorexit;
+        if (buffer_size < 8)
+            break;  // end of directory
+
+        for (offset = 0; offset + 8 <= buffer_size && count < max_count; offset += entry->rec_len) {
+            entry = (struct ext4_dir_entry *)(buffer + offset);
+            if (entry->rec_len == 0) {
+                end_of_dir = 1;
+                break;
+            }
+            if (entry->rec_len < 8) {
+                status = FSW_VOLUME_CORRUPTED;
+                goto errorexit;
+            }
+            if (entry->inode == 0)
+                continue;   // valid, but unused entry
+            if (entry->rec_len < 8 + entry->name_len || offset + 8 + entry->name_len > buffer_size) {
+                status = FSW_VOLUME_CORRUPTED;
+                goto errorexit;
+            }
+
+            // skip . and ..
+            if ((entry->name_len == 1 && entry->name[0] == '.') ||
+                (entry->name_len == 2 && entry->name[0] == '.' && entry->name[1] == '.'))
+                continue;
+
+            // setup a dnode for the child item
+            entry_name.len = entry_name.size = entry->name_len;
+            entry_name.data = entry->name;
+            status = fsw_dnode_create(dno, entry->inode, FSW_DNODE_TYPE_UNKNOWN, &entry_name, &child_dno);
+            if (status)
+                goto errorexit;
+            records[count++].dnode = &child_dno->g;
+        }
+        shand->pos = block_pos + offset;
+    }
+
+    fsw_free(buffer);
+    if (count == 0)
+        return FSW_NOT_FOUND;
+    *count_out = count;
+    return FSW_SUCCESS;
+
+errorexit:
+    fsw_dir_records_release(records, count);
+    fsw_free(buffer);
+    return status;
+}
+
 /**
  * Read a directory entry from the directory's raw data. This internal function is used
  * to read a raw ext2 directory entry into memory. The shandle's position pointer is adjusted
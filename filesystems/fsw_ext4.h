@@ -52,6 +52,16 @@ struct fsw_ext4_volume {
     fsw_u32     inode_size;         //!< Size of inode structure in bytes
 };
 
+/**
+ * ext4: Run of logical blocks that are stored in consecutive disk blocks.
+ */
+
+struct fsw_ext4_run {
+    fsw_u32     log_start;          //!< First logical block of the run
+    fsw_u32     log_count;          //!< Number of blocks in the run
+    fsw_u64     phys_start;         //!< Disk block of the first logical block
+};
+
 /**
  * ext2: Dnode structure with ext2-specific data.
  */
@@ -60,6 +70,11 @@ struct fsw_ext4_dnode {
     struct fsw_dnode g;             //!< Generic dnode structure
     
     struct ext4_inode *raw;         //!< Full raw inode structure
+    struct fsw_ext4_run *runs;      //!< Block map sorted by logical block, NULL until first used
+    fsw_u32     run_count;          //!< Number of runs in the block map
+    fsw_u32     run_alloc;          //!< Number of runs the block map has room for
+    fsw_u8      *map_done;          //!< Bitmap of the indirect blocks already decoded into the block map
+    fsw_u32     map_bcnt;           //!< Number of logical blocks covered by the block map
 };
 
 
@@ -384,6 +384,8 @@ struct ext4_super_block {
 /*
  * Feature set definitions (only the once we need for read support)
  */
+#define EXT4_FEATURE_COMPAT_DIR_INDEX           0x0020
+
 #define EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER     0x0001
 
 #define EXT4_FEATURE_INCOMPAT_COMPRESSION	0x0001
@@ -424,6 +426,53 @@ struct ext4_dir_entry {
 // NOTE: The original Linux kernel header defines ext4_dir_entry with the original
 //  layout and ext4_dir_entry_2 with the revised layout. We simply use the revised one.
 
+/*
+ * Hash tree (dir_index) directories. Block 0 of an indexed directory holds the
+ * "." and ".." entries, followed by the dx_root_info and the root's dx_entry
+ * array. Interior nodes are blocks with a single empty directory entry spanning
+ * the block, followed by a dx_entry array. The first dx_entry of every array
+ * holds the limit and count instead of a hash.
+ */
+struct dx_root_info {
+	__le32	reserved_zero;
+	__u8	hash_version;
+	__u8	info_length;	/* 8 */
+	__u8	indirect_levels;
+	__u8	unused_flags;
+};
+
+struct dx_entry {
+	__le32	hash;
+	__le32	block;
+};
+
+struct dx_countlimit {
+	__le16	limit;
+	__le16	count;
+};
+
+#define EXT4_DX_ROOT_INFO_OFFSET	24	/* after the "." and ".." entries */
+#define EXT4_DX_NODE_ENTRIES_OFFSET	8	/* after the empty directory entry */
+#define EXT4_HTREE_LEVEL		3	/* maximum depth with large_dir */
+
+/*
+ * Hash versions
+ */
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_LEGACY_UNSIGNED		3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED		5
+
+#define EXT4_HTREE_EOF_32BIT		0x7fffffffU
+
+/*
+ * Misc. superblock flags (s_flags)
+ */
+#define EXT2_FLAGS_SIGNED_HASH		0x0001	/* Signed dirhash in use */
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002	/* Unsigned dirhash in use */
+
 /*
  * Ext2 directory file types.  Only the low 3 bits are used.  The
  * other bits are reserved for now.
@@ -496,5 +545,13 @@ struct ext4_extent_header {
 
 #define EXT4_EXT_MAGIC		(0xf30a)
 
+/*
+ * An extent with ee_len above EXT_INIT_MAX_LEN is preallocated but not
+ * written yet, its length is ee_len - EXT_INIT_MAX_LEN.
+ */
+#define EXT_INIT_MAX_LEN	(1UL << 15)
+
+#define EXT4_MAX_EXTENT_DEPTH	5
+
 
 #endif
@@ -50,6 +50,7 @@ void dump_str(fsw_u16* p, fsw_u32 len, int swap)
 }
 #endif
 
+static fsw_status_t fsw_hfs_volume_probe(void *head, fsw_u32 head_size);
 static fsw_status_t fsw_hfs_volume_mount(struct fsw_hfs_volume *vol);
 static void         fsw_hfs_volume_free(struct fsw_hfs_volume *vol);
 static fsw_status_t fsw_hfs_volume_stat(struct fsw_hfs_volume *vol, struct fsw_volume_stat *sb);
@@ -91,6 +92,9 @@ struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(hfs) = {
     fsw_hfs_dir_lookup,  //retrieve the directory entry with the given name
     fsw_hfs_dir_read,	// next directory entry when reading a directory
     fsw_hfs_readlink,   // return FSW_UNSUPPORTED;
+    NULL,
+    (HFS_SUPERBLOCK_BLOCKNO + 1) * HFS_BLOCKSIZE,
+    fsw_hfs_volume_probe, // look for the H+ or HX signature
 };
 
 static const fsw_u16 fsw_latin_case_fold[] =
@@ -242,6 +246,26 @@ HFSGetDescription(CICell ih, char *str, long strMaxLen)
 */
 
 
+/**
+ * Probe for an HFS+ volume, either on its own or wrapped in a plain HFS volume.
+ */
+
+static fsw_status_t fsw_hfs_volume_probe(void *head, fsw_u32 head_size)
+{
+    HFSMasterDirectoryBlock   *mdb;
+    fsw_u16                   signature;
+
+    if (head_size < (HFS_SUPERBLOCK_BLOCKNO + 1) * HFS_BLOCKSIZE)
+        return FSW_UNSUPPORTED;
+    mdb = (HFSMasterDirectoryBlock *)((fsw_u8 *)head + HFS_SUPERBLOCK_BLOCKNO * HFS_BLOCKSIZE);
+    signature = be16_to_cpu(mdb->drSigWord);
+    if (signature == kHFSPlusSigWord || signature == kHFSXSigWord)
+        return FSW_SUCCESS;
+    if (signature == kHFSSigWord && be16_to_cpu(mdb->drEmbedSigWord) == kHFSPlusSigWord)
+        return FSW_SUCCESS;
+    return FSW_UNSUPPORTED;
+}
+
 static fsw_status_t fsw_hfs_volume_mount(struct fsw_hfs_volume *vol)
 {
     fsw_status_t              status, rv;
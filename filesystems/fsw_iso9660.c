@@ -80,6 +80,7 @@
 // extern MESSAGE_LOG_PROTOCOL *Msg;
 // functions
 
+static fsw_status_t fsw_iso9660_volume_probe(void *head, fsw_u32 head_size);
 static fsw_status_t fsw_iso9660_volume_mount(struct fsw_iso9660_volume *vol);
 static void         fsw_iso9660_volume_free(struct fsw_iso9660_volume *vol);
 static fsw_status_t fsw_iso9660_volume_stat(struct fsw_iso9660_volume *vol, struct fsw_volume_stat *sb);
@@ -123,6 +124,9 @@ struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(iso9660) = {
     fsw_iso9660_dir_lookup,
     fsw_iso9660_dir_read,
     fsw_iso9660_readlink,
+    NULL,
+    (ISO9660_SUPERBLOCK_BLOCKNO + 1) * ISO9660_BLOCKSIZE,
+    fsw_iso9660_volume_probe,
 };
 
 static fsw_status_t rr_find_sp(struct iso9660_dirrec *dirrec, struct fsw_rock_ridge_susp_sp **psp)
@@ -264,6 +268,23 @@ static void dump_dirrec(struct iso9660_dirrec *dirrec)
         DEBUG((DEBUG_INFO, "%d: (%d:%x)%c ", i, r[i], r[i], r[i]));
     }
 }*/
+/**
+ * Probe for an ISO9660 volume. The first volume descriptor must carry the
+ * standard identifier 'CD001', as the mount requires.
+ */
+
+static fsw_status_t fsw_iso9660_volume_probe(void *head, fsw_u32 head_size)
+{
+    struct iso9660_volume_descriptor *voldesc;
+
+    if (head_size < (ISO9660_SUPERBLOCK_BLOCKNO + 1) * ISO9660_BLOCKSIZE)
+        return FSW_UNSUPPORTED;
+    voldesc = (struct iso9660_volume_descriptor *)((fsw_u8 *)head + ISO9660_SUPERBLOCK_BLOCKNO * ISO9660_BLOCKSIZE);
+    if (!fsw_memeq(voldesc->standard_identifier, "CD001", 5))
+        return FSW_UNSUPPORTED;
+    return FSW_SUCCESS;
+}
+
 /**
  * Mount an ISO9660 volume. Reads the superblock and constructs the
  * root directory dnode.
@@ -361,6 +382,8 @@ static fsw_status_t fsw_iso9660_volume_mount(struct fsw_iso9660_volume *vol)
 
 #if 1
     status = fsw_block_get(vol, ISOINT(rootdir.extent_location), 0, &buffer);
+    if (status)
+        return status;
     sig = (char *)buffer + sua_pos;
     entry = (struct fsw_rock_ridge_susp_entry *)sig;
     if (   entry->sig[0] == 'S'
@@ -375,6 +398,7 @@ static fsw_status_t fsw_iso9660_volume_mount(struct fsw_iso9660_volume *vol)
 //          DBG("fsw_iso9660_volume_mount: SP magic isn't valid\n");
         }
     }
+    fsw_block_release(vol, ISOINT(rootdir.extent_location), buffer);
 #endif
     // release volume descriptors
     fsw_free(vol->primary_voldesc);
@@ -497,13 +521,21 @@ static fsw_status_t fsw_iso9660_dir_lookup(struct fsw_iso9660_volume *vol, struc
     struct fsw_shandle shand;
     struct iso9660_dirrec_buffer dirrec_buffer;
     struct iso9660_dirrec *dirrec = &dirrec_buffer.dirrec;
+    struct fsw_string_key lookup_key;
 
     // Preconditions: The caller has checked that dno is a directory node.
 
+    // prepare the name for comparing it with many directory entries
+    status = fsw_strkey_init(&lookup_key, FSW_STRING_TYPE_ISO88591, lookup_name);
+    if (status)
+        return status;
+
     // setup handle to read the directory
     status = fsw_shandle_open(dno, &shand);
-    if (status)
+    if (status) {
+        fsw_strkey_free(&lookup_key);
         return status;
+    }
 
     // scan the directory for the file
     while (1) {
@@ -523,7 +555,7 @@ static fsw_status_t fsw_iso9660_dir_lookup(struct fsw_iso9660_volume *vol, struc
             continue;
 
         // compare name
-        if (fsw_streq(lookup_name, &dirrec_buffer.name))  // TODO: compare case-insensitively
+        if (fsw_strkey_eq(&lookup_key, &dirrec_buffer.name))  // TODO: compare case-insensitively
             break;
     }
 
@@ -534,6 +566,7 @@ static fsw_status_t fsw_iso9660_dir_lookup(struct fsw_iso9660_volume *vol, struc
 
 errorexit:
     fsw_shandle_close(&shand);
+    fsw_strkey_free(&lookup_key);
     return status;
 }
 
@@ -113,9 +113,12 @@ int fsw_streq(struct fsw_string *s1, struct fsw_string *s2)
         return 1;
 
     if (s1->type == s2->type) {
-        // same type, do a dumb memory compare
+        // same type, do a dumb memory compare; names often share a prefix,
+        // so the last byte rejects most mismatches
         if (s1->size != s2->size)
             return 0;
+        if (((fsw_u8 *)s1->data)[s1->size - 1] != ((fsw_u8 *)s2->data)[s1->size - 1])
+            return 0;
         return fsw_memeq(s1->data, s2->data, s1->size);
     }
 
@@ -280,6 +283,51 @@ void fsw_strsplit(struct fsw_string *element, struct fsw_string *buffer, char se
     // TODO: support UTF8 and UTF16_SWAPPED
 }
 
+/**
+ * Compute a hash of the characters of a string. The hash does not depend on the
+ * encoding, so strings considered equal by fsw_streq have the same hash. It never
+ * returns 0, which callers may use to mark a hash as not computed.
+ */
+
+fsw_u32 fsw_strhash(struct fsw_string *s)
+{
+    fsw_u32         hash = 2166136261U;
+    fsw_u32         c;
+    int             i;
+    fsw_u8          *p8;
+    fsw_u16         *p16;
+
+    if (s->type == FSW_STRING_TYPE_EMPTY)
+        return hash;
+
+    p8 = (fsw_u8 *)s->data;
+    p16 = (fsw_u16 *)s->data;
+    for (i = 0; i < s->len; i++) {
+        if (s->type == FSW_STRING_TYPE_ISO88591) {
+            c = *p8++;
+        } else if (s->type == FSW_STRING_TYPE_UTF8) {
+            c = *p8++;
+            if ((c & 0xe0) == 0xc0) {
+                c = ((c & 0x1f) << 6) | (*p8++ & 0x3f);
+            } else if ((c & 0xf0) == 0xe0) {
+                c = ((c & 0x0f) << 12) | ((*p8++ & 0x3f) << 6);
+                c |= (*p8++ & 0x3f);
+            } else if ((c & 0xf8) == 0xf0) {
+                c = ((c & 0x07) << 18) | ((*p8++ & 0x3f) << 12);
+                c |= ((*p8++ & 0x3f) << 6);
+                c |= (*p8++ & 0x3f);
+            }
+        } else if (s->type == FSW_STRING_TYPE_UTF16) {
+            c = *p16++;
+        } else {
+            c = *p16++;
+            c = FSW_SWAPVALUE_U16(c);
+        }
+        hash = (hash ^ c) * 16777619U;
+    }
+    return hash ? hash : 1;
+}
+
 /**
  * Frees the memory used by a string returned from fsw_strdup_coerce.
  */
@@ -291,4 +339,89 @@ void fsw_strfree(struct fsw_string *s)
     s->type = FSW_STRING_TYPE_EMPTY;
 }
 
+/**
+ * Prepare a string for repeated comparisons against strings of the given encoding,
+ * typically the name passed to a file system's dir_lookup function. If the string
+ * has another encoding, a converted copy is made once, so fsw_strkey_eq can use a
+ * memory compare for each candidate instead of converting characters. A string with
+ * characters that ISO 8859-1 cannot represent never equals an ISO 8859-1 string,
+ * so no copy is made and fsw_strkey_eq fails immediately.
+ *
+ * If the function returns FSW_SUCCESS, the caller must call fsw_strkey_free later.
+ * The source string must stay valid as long as the key is used.
+ */
+
+fsw_status_t fsw_strkey_init(struct fsw_string_key *key, int type, struct fsw_string *src)
+{
+    fsw_status_t    status;
+    fsw_u32         c;
+    int             i;
+
+    key->str = *src;
+    key->hash = fsw_strhash(src);
+    key->owned = 0;
+    key->nomatch = 0;
+    if (src->type == type || src->type == FSW_STRING_TYPE_EMPTY || src->len == 0)
+        return FSW_SUCCESS;
+
+    if (type == FSW_STRING_TYPE_ISO88591 &&
+        (src->type == FSW_STRING_TYPE_UTF16 || src->type == FSW_STRING_TYPE_UTF16_SWAPPED)) {
+        for (i = 0; i < src->len; i++) {
+            c = ((fsw_u16 *)src->data)[i];
+            if (src->type == FSW_STRING_TYPE_UTF16_SWAPPED)
+                c = FSW_SWAPVALUE_U16(c);
+            if (c > 0xff) {
+                key->nomatch = 1;
+                return FSW_SUCCESS;
+            }
+        }
+    } else if (src->type != FSW_STRING_TYPE_ISO88591) {
+        // the conversion might lose characters, keep comparing with fsw_streq
+        return FSW_SUCCESS;
+    }
+
+    status = fsw_strdup_coerce(&key->str, type, src);
+    if (status == FSW_UNSUPPORTED) {
+        key->str = *src;
+        return FSW_SUCCESS;
+    }
+    if (status)
+        return status;
+    key->owned = 1;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Compare a prepared string with another string. Returns boolean true if fsw_streq
+ * would consider the key's source string and the given string equal.
+ */
+
+int fsw_strkey_eq(struct fsw_string_key *key, struct fsw_string *s)
+{
+    if (key->nomatch)
+        return 0;
+    if (s->type != key->str.type || s->type == FSW_STRING_TYPE_EMPTY)
+        return fsw_streq(&key->str, s);
+
+    // same type: length, last byte and then memory compare
+    if (s->len != key->str.len || s->size != key->str.size)
+        return 0;
+    if (s->len == 0)
+        return 1;
+    if (((fsw_u8 *)s->data)[s->size - 1] != ((fsw_u8 *)key->str.data)[s->size - 1])
+        return 0;
+    return fsw_memeq(s->data, key->str.data, s->size);
+}
+
+/**
+ * Free the memory used by a key set up with fsw_strkey_init.
+ */
+
+void fsw_strkey_free(struct fsw_string_key *key)
+{
+    if (key->owned)
+        fsw_strfree(&key->str);
+    key->owned = 0;
+}
+
 // EOF
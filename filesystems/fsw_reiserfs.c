@@ -26,6 +26,7 @@
 
 // functions
 
+static fsw_status_t fsw_reiserfs_volume_probe(void *head, fsw_u32 head_size);
 static fsw_status_t fsw_reiserfs_volume_mount(struct fsw_reiserfs_volume *vol);
 static void         fsw_reiserfs_volume_free(struct fsw_reiserfs_volume *vol);
 static fsw_status_t fsw_reiserfs_volume_stat(struct fsw_reiserfs_volume *vol, struct fsw_volume_stat *sb);
@@ -72,6 +73,9 @@ struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(reiserfs) = {
     fsw_reiserfs_dir_lookup,
     fsw_reiserfs_dir_read,
     fsw_reiserfs_readlink,
+    NULL,
+    REISERFS_DISK_OFFSET_IN_BYTES + sizeof(struct reiserfs_super_block),
+    fsw_reiserfs_volume_probe,
 };
 
 // misc data
@@ -82,6 +86,50 @@ static fsw_u32  superblock_offsets[3] = {
     0
 };
 
+/**
+ * Check the superblock for one of the magic strings and return the format
+ * version through version_out.
+ */
+
+static fsw_status_t fsw_reiserfs_check_magic(struct reiserfs_super_block *sb, int *version_out)
+{
+    if (fsw_memeq(sb->s_v1.s_magic,
+                  REISERFS_SUPER_MAGIC_STRING, 8)) {
+        *version_out = REISERFS_VERSION_1;
+        return FSW_SUCCESS;
+    } else if (fsw_memeq(sb->s_v1.s_magic,
+                         REISER2FS_SUPER_MAGIC_STRING, 9)) {
+        *version_out = REISERFS_VERSION_2;
+        return FSW_SUCCESS;
+    } else if (fsw_memeq(sb->s_v1.s_magic,
+                         REISER2FS_JR_SUPER_MAGIC_STRING, 9)) {
+        *version_out = sb->s_v1.s_version;
+        if (*version_out == REISERFS_VERSION_1 || *version_out == REISERFS_VERSION_2)
+            return FSW_SUCCESS;
+    }
+    return FSW_UNSUPPORTED;
+}
+
+/**
+ * Probe for a reiserfs volume. Looks for a magic string at both superblock
+ * locations in the given head of the volume.
+ */
+
+static fsw_status_t fsw_reiserfs_volume_probe(void *head, fsw_u32 head_size)
+{
+    fsw_u32         offset;
+    int             i, version;
+
+    for (i = 0; superblock_offsets[i]; i++) {
+        offset = superblock_offsets[i] << REISERFS_SUPERBLOCK_BLOCKSIZEBITS;
+        if (head_size >= offset + sizeof(struct reiserfs_super_block) &&
+            fsw_reiserfs_check_magic((struct reiserfs_super_block *)((fsw_u8 *)head + offset),
+                                     &version) == FSW_SUCCESS)
+            return FSW_SUCCESS;
+    }
+    return FSW_UNSUPPORTED;
+}
+
 /**
  * Mount an reiserfs volume. Reads the superblock and constructs the
  * root directory dnode.
@@ -110,20 +158,8 @@ static fsw_status_t fsw_reiserfs_volume_mount(struct fsw_reiserfs_volume *vol)
         fsw_block_release(vol, superblock_offsets[i], buffer);
 
         // check for one of the magic strings
-        if (fsw_memeq(vol->sb->s_v1.s_magic,
-                      REISERFS_SUPER_MAGIC_STRING, 8)) {
-            vol->version = REISERFS_VERSION_1;
-            break;
-        } else if (fsw_memeq(vol->sb->s_v1.s_magic,
-                             REISER2FS_SUPER_MAGIC_STRING, 9)) {
-            vol->version = REISERFS_VERSION_2;
+        if (fsw_reiserfs_check_magic(vol->sb, &vol->version) == FSW_SUCCESS)
             break;
-        } else if (fsw_memeq(vol->sb->s_v1.s_magic,
-                             REISER2FS_JR_SUPER_MAGIC_STRING, 9)) {
-            vol->version = vol->sb->s_v1.s_version;
-            if (vol->version == REISERFS_VERSION_1 || vol->version == REISERFS_VERSION_2)
-                break;
-        }
     }
     if (superblock_offsets[i] == 0)
         return FSW_UNSUPPORTED;
@@ -432,6 +468,7 @@ static fsw_status_t fsw_reiserfs_dir_lookup(struct fsw_reiserfs_volume *vol, str
     fsw_u32         child_dir_id;
     struct reiserfs_de_head *dhead;
     struct fsw_string entry_name;
+    struct fsw_string_key lookup_key;
 
     // Preconditions: The caller has checked that dno is a directory node.
 
@@ -440,12 +477,20 @@ static fsw_status_t fsw_reiserfs_dir_lookup(struct fsw_reiserfs_volume *vol, str
 
     entry_name.type = FSW_STRING_TYPE_ISO88591;
 
+    // prepare the name for comparing it with many directory entries
+    status = fsw_strkey_init(&lookup_key, FSW_STRING_TYPE_ISO88591, lookup_name);
+    if (status)
+        return status;
+
     // get the item for that position
     status = fsw_reiserfs_item_search(vol, dno->dir_id, dno->g.dnode_id, FIRST_ITEM_OFFSET, &item);
-    if (status)
+    if (status) {
+        fsw_strkey_free(&lookup_key);
         return status;
+    }
     if (item.item_offset == 0) {
         fsw_reiserfs_item_release(vol, &item);
+        fsw_strkey_free(&lookup_key);
         return FSW_NOT_FOUND;       // empty directory or something
     }
 
@@ -466,13 +511,14 @@ static fsw_status_t fsw_reiserfs_dir_lookup(struct fsw_reiserfs_volume *vol, str
             entry_name.data = item.item_data + name_offset;
 
             // compare name
-            if (fsw_streq(lookup_name, &entry_name)) {
+            if (fsw_strkey_eq(&lookup_key, &entry_name)) {
                 // found the entry we're looking for!
 
                 // setup a dnode for the child item
                 status = fsw_dnode_create(dno, dhead->deh_objectid, FSW_DNODE_TYPE_UNKNOWN, &entry_name, child_dno_out);
                 child_dir_id = dhead->deh_dir_id;
                 fsw_reiserfs_item_release(vol, &item);
+                fsw_strkey_free(&lookup_key);
                 if (status)
                     return status;
                 (*child_dno_out)->dir_id = child_dir_id;
@@ -485,8 +531,10 @@ static fsw_status_t fsw_reiserfs_dir_lookup(struct fsw_reiserfs_volume *vol, str
         // item of the directory.
 
         status = fsw_reiserfs_item_next(vol, &item);
-        if (status)
+        if (status) {
+            fsw_strkey_free(&lookup_key);
             return status;
+        }
 
     }
 }
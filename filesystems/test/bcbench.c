@@ -0,0 +1,307 @@
+/**
+ * \file bcbench.c
+ * Benchmark for the core block cache in the POSIX user space environment.
+ *
+ * Mounts a synthetic volume whose "disk" is generated in memory, fills the
+ * block cache with a given number of blocks and then measures the average
+ * cost of a cache hit (fsw_block_get plus fsw_block_release) for growing
+ * cache sizes. With a hashed cache index the per-lookup cost stays flat.
+ *
+ * A second run streams a large file's worth of level 0 blocks through a
+ * small cache and checks how many directory and inode blocks survive it.
+ * A third run fills most of the cache with high-level blocks that are used
+ * once, then counts misses for a smaller working set cycled through it.
+ * A fourth run holds more blocks than a byte budget allows, then releases
+ * them and checks that the cache gives the memory back.
+ */
+
+/*-
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "fsw_posix.h"
+
+#include <time.h>
+
+#define BENCH_BLOCKSIZE (512)
+#define BENCH_LOOKUPS   (2000000)
+
+static fsw_u32 bench_cache_size;
+static fsw_u64 bench_reads;
+
+static fsw_status_t bench_volume_mount(struct fsw_volume *vol)
+{
+    fsw_set_blocksize(vol, BENCH_BLOCKSIZE, BENCH_BLOCKSIZE);
+    vol->bcache_size = bench_cache_size;
+    return FSW_SUCCESS;
+}
+
+static void bench_volume_free(struct fsw_volume *vol)
+{
+}
+
+static struct fsw_fstype_table bench_fstype_table = {
+    { FSW_STRING_TYPE_ISO88591, 5, 5, "bench" },
+    sizeof(struct fsw_volume),
+    sizeof(struct fsw_dnode),
+
+    bench_volume_mount,
+    bench_volume_free,
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+static void bench_change_blocksize(struct fsw_volume *vol,
+                                   fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
+                                   fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize)
+{
+}
+
+static fsw_status_t bench_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer)
+{
+    bench_reads++;
+    memset(buffer, (int)phys_bno, vol->phys_blocksize);
+    return FSW_SUCCESS;
+}
+
+static struct fsw_host_table bench_host_table = {
+    FSW_STRING_TYPE_ISO88591,
+
+    bench_change_blocksize,
+    bench_read_block
+};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int bench_one(fsw_u32 cache_size)
+{
+    struct fsw_volume *vol;
+    fsw_status_t    status;
+    fsw_u64         bno, seed;
+    fsw_u32         i;
+    void            *buffer;
+    double          start, elapsed;
+
+    bench_cache_size = cache_size;
+    status = fsw_mount(NULL, &bench_host_table, &bench_fstype_table, &vol);
+    if (status) {
+        fprintf(stderr, "fsw_mount returned %d\n", status);
+        return 1;
+    }
+
+    // fill the cache; blocks are spread with a stride to mimic metadata placement
+    for (i = 0; i < cache_size; i++) {
+        bno = (fsw_u64)i * 8;
+        if (fsw_block_get(vol, bno, 2, &buffer))
+            return 1;
+        fsw_block_release(vol, bno, buffer);
+    }
+    bench_reads = 0;
+
+    // random hits
+    seed = 12345;
+    start = now_ns();
+    for (i = 0; i < BENCH_LOOKUPS; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        bno = (seed >> 33) % cache_size * 8;
+        if (fsw_block_get(vol, bno, 2, &buffer))
+            return 1;
+        fsw_block_release(vol, bno, buffer);
+    }
+    elapsed = now_ns() - start;
+
+    printf("%8u blocks: %8.1f ns/lookup, %llu host reads\n",
+           cache_size, elapsed / BENCH_LOOKUPS, (unsigned long long)bench_reads);
+
+    fsw_unmount(vol);
+    return 0;
+}
+
+static int bench_stream(fsw_u32 cache_size, fsw_u32 stream_blocks)
+{
+    struct fsw_volume *vol;
+    fsw_status_t    status;
+    fsw_u64         bno;
+    fsw_u32         i, round, meta_blocks;
+    void            *buffer;
+
+    bench_cache_size = cache_size;
+    status = fsw_mount(NULL, &bench_host_table, &bench_fstype_table, &vol);
+    if (status) {
+        fprintf(stderr, "fsw_mount returned %d\n", status);
+        return 1;
+    }
+
+    // a working set of directory (level 1) and inode (level 2) blocks, used twice
+    meta_blocks = cache_size / 4;
+    for (round = 0; round < 2; round++) {
+        for (i = 0; i < meta_blocks; i++) {
+            if (fsw_block_get(vol, i, 1 + (i & 1), &buffer))
+                return 1;
+            fsw_block_release(vol, i, buffer);
+        }
+    }
+
+    // stream file data through the cache
+    for (i = 0; i < stream_blocks; i++) {
+        bno = 1000000 + i;
+        if (fsw_block_get(vol, bno, 0, &buffer))
+            return 1;
+        fsw_block_release(vol, bno, buffer);
+    }
+
+    // the next lookup needs the metadata again
+    bench_reads = 0;
+    for (i = 0; i < meta_blocks; i++) {
+        if (fsw_block_get(vol, i, 1 + (i & 1), &buffer))
+            return 1;
+        fsw_block_release(vol, i, buffer);
+    }
+    printf("%8u blocks: %u of %u metadata blocks re-read after streaming %u data blocks\n",
+           vol->bcache_size, (unsigned)bench_reads, meta_blocks, stream_blocks);
+
+    fsw_unmount(vol);
+    return 0;
+}
+
+static int bench_stale(fsw_u32 cache_size)
+{
+    struct fsw_volume *vol;
+    fsw_status_t    status;
+    fsw_u64         bno;
+    fsw_u32         i, round, work_blocks;
+    void            *buffer;
+
+    bench_cache_size = cache_size;
+    status = fsw_mount(NULL, &bench_host_table, &bench_fstype_table, &vol);
+    if (status) {
+        fprintf(stderr, "fsw_mount returned %d\n", status);
+        return 1;
+    }
+
+    // mount-time metadata at a high level, never used again
+    for (i = 0; i < cache_size * 3 / 4; i++) {
+        bno = 1000000 + i;
+        if (fsw_block_get(vol, bno, 4, &buffer))
+            return 1;
+        fsw_block_release(vol, bno, buffer);
+    }
+
+    // cycle a directory working set of half the cache size
+    work_blocks = cache_size / 2;
+    bench_reads = 0;
+    for (round = 0; round < 10; round++) {
+        for (i = 0; i < work_blocks; i++) {
+            if (fsw_block_get(vol, i, 1, &buffer))
+                return 1;
+            fsw_block_release(vol, i, buffer);
+        }
+    }
+    printf("%8u blocks: %u host reads for 10 rounds over %u directory blocks\n",
+           vol->bcache_size, (unsigned)bench_reads, work_blocks);
+
+    fsw_unmount(vol);
+    return 0;
+}
+
+static int bench_budget(fsw_u32 budget, fsw_u32 held_blocks)
+{
+    struct fsw_volume *vol;
+    fsw_status_t    status;
+    fsw_u64         bno;
+    fsw_u32         i, global_peak;
+    void            *buffer, **buffers;
+
+    bench_cache_size = 16;
+    bench_host_table.bcache_volume_budget = budget;
+    status = fsw_mount(NULL, &bench_host_table, &bench_fstype_table, &vol);
+    bench_host_table.bcache_volume_budget = 0;
+    if (status) {
+        fprintf(stderr, "fsw_mount returned %d\n", status);
+        return 1;
+    }
+
+    // stream through the cache; it must stay within budget
+    for (i = 0; i < 60 * 2048; i++) {
+        bno = 1000000 + i;
+        if (fsw_block_get(vol, bno, 0, &buffer))
+            return 1;
+        fsw_block_release(vol, bno, buffer);
+    }
+    printf("%8u bytes budget: %u bytes after streaming, %u blocks", budget,
+           vol->bcache_bytes, vol->bcache_size);
+
+    // hold more blocks at once than the budget allows
+    buffers = malloc(held_blocks * sizeof(void *));
+    for (i = 0; i < held_blocks; i++) {
+        if (fsw_block_get(vol, i, 2, &buffers[i]))
+            return 1;
+    }
+    for (i = 0; i < held_blocks; i++)
+        fsw_block_release(vol, i, buffers[i]);
+    free(buffers);
+
+    fsw_blockcache_global_usage(NULL, &global_peak);
+    printf(", peak %u bytes holding %u blocks, %u bytes after release (global peak %u)\n",
+           vol->bcache_peak_bytes, held_blocks, vol->bcache_bytes, global_peak);
+
+    fsw_unmount(vol);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    fsw_u32 cache_size;
+
+    for (cache_size = 256; cache_size <= 262144; cache_size <<= 2) {
+        if (bench_one(cache_size))
+            return 1;
+    }
+
+    // 60 MiB initrd in 512 byte blocks
+    for (cache_size = 16; cache_size <= 1024; cache_size <<= 2) {
+        if (bench_stream(cache_size, 60 * 2048))
+            return 1;
+    }
+
+    for (cache_size = 16; cache_size <= 1024; cache_size <<= 2) {
+        if (bench_stale(cache_size))
+            return 1;
+    }
+
+    for (cache_size = 16; cache_size <= 1024; cache_size <<= 2) {
+        if (bench_budget(64 * 1024, cache_size))
+            return 1;
+    }
+
+    return 0;
+}
+
+// EOF
@@ -0,0 +1,277 @@
+/**
+ * \file dirbench.c
+ * Directory listing benchmark for the POSIX user space environment.
+ *
+ * Lists a directory of a disk image the way a boot loader scanning for kernels
+ * does: every entry is stat'ed and kept open until the listing is done. A second
+ * pass lists the directory again while all dnodes are still alive, which is
+ * where the lookup of existing dnodes dominates. Then every entry is stat'ed
+ * a few more times, as repeated GetInfo calls from the boot menu do. Finally the
+ * directory is listed without keeping entries, once an entry at a time and once
+ * with fsw_dnode_dir_read_batch. Last, a sample of the entries and as many names
+ * that do not exist are looked up by name.
+ *
+ * A suitable image with 10000 entries can be made with
+ *   mkdir -p img/many && (cd img/many && seq -f "vmlinuz-%05g" 1 10000 | xargs touch)
+ *   mke2fs -t ext4 -O ^64bit -d img dir10k.img 64M
+ * and listed with "./dirbench dir10k.img /many". For the lookups through an ext4
+ * hash tree, make 50000 entries in a 128M image with "-N 60000" and index the
+ * directory with "e2fsck -fyD dir50k.img".
+ */
+
+/*-
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "fsw_posix.h"
+
+#include <time.h>
+
+#define STAT_ROUNDS (10)
+#define BATCH_SIZE  (16)
+#define LOOKUP_STRIDE (50)
+
+extern struct fsw_fstype_table FSW_FSTYPE_TABLE_NAME(FSTYPE);
+
+static double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void stat_time(struct fsw_dnode_stat *sb, int which, fsw_u32 posix_time)
+{
+}
+
+static void stat_attr(struct fsw_dnode_stat *sb, fsw_u16 posix_mode)
+{
+}
+
+/**
+ * List the directory once, keeping every entry. Returns the number of entries,
+ * or -1 on error.
+ */
+
+static int list_pass(struct fsw_posix_volume *pvol, const char *path, struct fsw_dnode **dnos, int max_dnos)
+{
+    struct fsw_posix_dir *dir;
+    struct fsw_dnode *dno;
+    int count = 0;
+
+    dir = fsw_posix_opendir(pvol, path);
+    if (dir == NULL)
+        return -1;
+    while (fsw_dnode_dir_read(&dir->shand, &dno) == FSW_SUCCESS) {
+        if (fsw_dnode_fill(dno) != FSW_SUCCESS || count >= max_dnos) {
+            fsw_dnode_release(dno);
+            break;
+        }
+        dnos[count++] = dno;
+    }
+    fsw_posix_closedir(dir);
+    return count;
+}
+
+/**
+ * List and stat the directory an entry at a time, releasing each entry.
+ */
+
+static int entry_pass(struct fsw_posix_volume *pvol, const char *path)
+{
+    struct fsw_posix_dir *dir;
+    struct fsw_dnode *dno;
+    struct fsw_dnode_stat sb;
+    int count = 0;
+
+    dir = fsw_posix_opendir(pvol, path);
+    if (dir == NULL)
+        return -1;
+    sb.store_time_posix = stat_time;
+    sb.store_attr_posix = stat_attr;
+    sb.host_data = NULL;
+    while (fsw_dnode_dir_read(&dir->shand, &dno) == FSW_SUCCESS) {
+        if (fsw_dnode_stat(dno, &sb) == FSW_SUCCESS)
+            count++;
+        fsw_dnode_release(dno);
+    }
+    fsw_posix_closedir(dir);
+    return count;
+}
+
+/**
+ * List and stat the directory in batches of records.
+ */
+
+static int batch_pass(struct fsw_posix_volume *pvol, const char *path)
+{
+    struct fsw_posix_dir *dir;
+    struct fsw_dir_record records[BATCH_SIZE];
+    fsw_u32 n;
+    int count = 0;
+
+    dir = fsw_posix_opendir(pvol, path);
+    if (dir == NULL)
+        return -1;
+    while (fsw_dnode_dir_read_batch(&dir->shand, records, BATCH_SIZE, &n) == FSW_SUCCESS) {
+        count += n;
+        fsw_dir_records_release(records, n);
+    }
+    fsw_posix_closedir(dir);
+    return count;
+}
+
+/**
+ * Count the fsw_block_get calls of a volume so far.
+ */
+
+static fsw_u32 block_gets(struct fsw_volume *vol)
+{
+    fsw_u32 level, count = 0;
+
+    for (level = 0; level <= FSW_MAX_CACHE_LEVEL; level++)
+        count += vol->stats.cache_hits[level] + vol->stats.cache_misses[level];
+    return count;
+}
+
+/**
+ * Look up every LOOKUP_STRIDE-th of the listed entries by name, and as many names
+ * that are not in the directory. Every name is looked up once, so the core's lookup
+ * cache does not come into play. Returns the number of names found, or -1 on error.
+ */
+
+static int lookup_pass(struct fsw_posix_volume *pvol, const char *path,
+                       struct fsw_dnode **dnos, int count, int *lookups_out)
+{
+    struct fsw_posix_dir *dir;
+    struct fsw_dnode *child_dno;
+    struct fsw_string name;
+    char buffer[32];
+    int i, found = 0, lookups = 0;
+
+    dir = fsw_posix_opendir(pvol, path);
+    if (dir == NULL)
+        return -1;
+    for (i = 0; i < count; i += LOOKUP_STRIDE) {
+        lookups++;
+        if (fsw_dnode_lookup(dir->shand.dnode, &dnos[i]->name, &child_dno) == FSW_SUCCESS) {
+            found++;
+            fsw_dnode_release(child_dno);
+        }
+
+        name.type = FSW_STRING_TYPE_ISO88591;
+        name.len = name.size = snprintf(buffer, sizeof(buffer), "missing-%05d", i);
+        name.data = buffer;
+        lookups++;
+        if (fsw_dnode_lookup(dir->shand.dnode, &name, &child_dno) == FSW_SUCCESS) {
+            found++;
+            fsw_dnode_release(child_dno);
+        }
+    }
+    fsw_posix_closedir(dir);
+    *lookups_out = lookups;
+    return found;
+}
+
+int main(int argc, char **argv)
+{
+    struct fsw_posix_volume *pvol;
+    struct fsw_dnode **dnos;
+    struct fsw_dnode_stat sb;
+    int max_dnos = 1000000, count, count2, i, round, found, lookups;
+    double start, first, second, stat;
+    fsw_u64 reads;
+    fsw_u32 gets;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: dirbench <file/device> <directory>\n");
+        return 1;
+    }
+
+    pvol = fsw_posix_mount(argv[1], NULL);
+    if (pvol == NULL)
+        return 1;
+    dnos = malloc(2 * max_dnos * sizeof(struct fsw_dnode *));
+    if (dnos == NULL)
+        return 1;
+
+    reads = pvol->host_reads;
+    start = now_ms();
+    count = list_pass(pvol, argv[2], dnos, max_dnos);
+    first = now_ms() - start;
+    if (count < 0)
+        return 1;
+
+    start = now_ms();
+    count2 = list_pass(pvol, argv[2], dnos + count, max_dnos);
+    second = now_ms() - start;
+    if (count2 < 0)
+        return 1;
+
+    printf("%d entries: first listing %.1f ms, second listing %.1f ms, %llu host reads\n",
+           count, first, second, (unsigned long long)(pvol->host_reads - reads));
+
+    sb.store_time_posix = stat_time;
+    sb.store_attr_posix = stat_attr;
+    sb.host_data = NULL;
+    reads = pvol->host_reads;
+    start = now_ms();
+    for (round = 0; round < STAT_ROUNDS; round++) {
+        for (i = 0; i < count; i++) {
+            if (fsw_dnode_stat(dnos[i], &sb) != FSW_SUCCESS)
+                return 1;
+        }
+    }
+    stat = now_ms() - start;
+    printf("%d entries: %d stat rounds %.1f ms, %llu host reads\n",
+           count, STAT_ROUNDS, stat, (unsigned long long)(pvol->host_reads - reads));
+
+    gets = block_gets(pvol->vol);
+    start = now_ms();
+    found = lookup_pass(pvol, argv[2], dnos, count, &lookups);
+    stat = now_ms() - start;
+    if (found < 0)
+        return 1;
+    printf("%d lookups, %d found: %.1f ms, %.1f blocks per lookup\n",
+           lookups, found, stat, (double)(block_gets(pvol->vol) - gets) / lookups);
+
+    for (i = 0; i < count + count2; i++)
+        fsw_dnode_release(dnos[i]);
+    free(dnos);
+
+    start = now_ms();
+    count = entry_pass(pvol, argv[2]);
+    first = now_ms() - start;
+    start = now_ms();
+    count2 = batch_pass(pvol, argv[2]);
+    second = now_ms() - start;
+    printf("%d/%d entries: listing an entry at a time %.1f ms, in batches of %d %.1f ms\n",
+           count, count2, first, BATCH_SIZE, second);
+    fsw_posix_unmount(pvol);
+    return 0;
+}
+
+// EOF
@@ -37,6 +37,7 @@
 
 #include "fsw_posix.h"
 
+#include <time.h>
 
 #ifndef FSTYPE
 /** The file system type name to use. */
@@ -52,7 +53,11 @@ fsw_status_t fsw_posix_open_dno(struct fsw_posix_volume *pvol, const char *path,
 void fsw_posix_change_blocksize(struct fsw_volume *vol,
                               fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
                               fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize);
-fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer);
+fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
+fsw_status_t fsw_posix_read_blocks(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer);
+fsw_status_t fsw_posix_block_get(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out);
+fsw_status_t fsw_posix_block_release(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
+fsw_u64 fsw_posix_clock(void);
 
 /**
  * Dispatch table for our FSW host driver.
@@ -62,12 +67,44 @@ struct fsw_host_table   fsw_posix_host_table = {
     FSW_STRING_TYPE_ISO88591,
 
     fsw_posix_change_blocksize,
-    fsw_posix_read_block
+    fsw_posix_read_block,
+    fsw_posix_read_blocks,
+    fsw_posix_block_get,
+    fsw_posix_block_release,
+    0,
+    0,
+    fsw_posix_clock
 };
 
 extern struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(FSTYPE);
 
 
+/**
+ * Let the file system driver look for its signature in the start of the
+ * file/device, the way the EFI host does before it mounts a volume.
+ */
+
+static fsw_status_t fsw_posix_probe(struct fsw_posix_volume *pvol, struct fsw_fstype_table *fstype_table)
+{
+    fsw_status_t        status;
+    void                *head;
+    ssize_t             head_size;
+
+    if (fstype_table->volume_probe == NULL)
+        return FSW_SUCCESS;
+    status = fsw_alloc(fstype_table->probe_size, &head);
+    if (status)
+        return status;
+    head_size = pread(pvol->fd, head, fstype_table->probe_size, 0);
+    if (head_size < 0) {
+        fsw_free(head);
+        return FSW_IO_ERROR;
+    }
+    status = fstype_table->volume_probe(head, (fsw_u32)head_size);
+    fsw_free(head);
+    return status;
+}
+
 /**
  * Mount function.
  */
@@ -94,9 +131,13 @@ struct fsw_posix_volume * fsw_posix_mount(const char *path, struct fsw_fstype_ta
     // mount the filesystem
     if (fstype_table == NULL)
         fstype_table = &FSW_FSTYPE_TABLE_NAME(FSTYPE);
-    status = fsw_mount(pvol, &fsw_posix_host_table, fstype_table, &pvol->vol);
+    status = fsw_posix_probe(pvol, fstype_table);
+    if (status == FSW_SUCCESS)
+        status = fsw_mount(pvol, &fsw_posix_host_table, fstype_table, &pvol->vol);
     if (status) {
         fprintf(stderr, "fsw_posix_mount: fsw_mount returned %d\n", status);
+        if (pvol->data_block != NULL)
+            fsw_free(pvol->data_block);
         fsw_free(pvol);
         return NULL;
     }
@@ -112,10 +153,38 @@ int fsw_posix_unmount(struct fsw_posix_volume *pvol)
 {
     if (pvol->vol != NULL)
         fsw_unmount(pvol->vol);
+    if (pvol->data_block != NULL)
+        fsw_free(pvol->data_block);
     fsw_free(pvol);
     return 0;
 }
 
+/**
+ * Print the core's counters for a volume.
+ */
+
+void fsw_posix_print_stats(struct fsw_posix_volume *pvol, FILE *out)
+{
+    struct fsw_volume *vol = pvol->vol;
+    struct fsw_volume_stats *stats = &vol->stats;
+    fsw_u32 level;
+
+    fprintf(out, "block cache: %u entries, %u bytes (peak %u), %u evictions, %u grows, %u blocks read ahead\n",
+            vol->bcache_size, vol->bcache_bytes, vol->bcache_peak_bytes,
+            stats->cache_evictions, stats->cache_grows, stats->readahead_blocks);
+    for (level = 0; level <= FSW_MAX_CACHE_LEVEL; level++) {
+        if (stats->cache_hits[level] == 0 && stats->cache_misses[level] == 0)
+            continue;
+        fprintf(out, "  level %u: %u hits, %u misses\n",
+                level, stats->cache_hits[level], stats->cache_misses[level]);
+    }
+    fprintf(out, "host: %u blocks from block_get, %u read calls of %llu bytes in %.3f ms\n",
+            stats->host_block_gets, stats->host_read_calls,
+            (unsigned long long)stats->host_read_bytes, stats->host_read_time / 1e6);
+    fprintf(out, "dnodes: %u fills, %u revived, %u arena objects in %u chunks\n",
+            vol->dnode_fills, vol->dnode_revived, vol->arena_allocs, vol->arena_chunk_count);
+}
+
 /**
  * Open a named regular file.
  */
@@ -354,7 +423,7 @@ void fsw_posix_change_blocksize(struct fsw_volume *vol,
                                 fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
                                 fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize)
 {
-    // nothing to do
+    // nothing to do, fsw_posix_block_get enlarges the data block buffer as needed
 }
 
 /**
@@ -362,7 +431,7 @@ void fsw_posix_change_blocksize(struct fsw_volume *vol,
  * to read a block of data from the device. The buffer is allocated by the core code.
  */
 
-fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer)
+fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer)
 {
     struct fsw_posix_volume *pvol = (struct fsw_posix_volume *)vol->host_data;
     off_t           block_offset, seek_result;
@@ -378,10 +447,98 @@ fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u32 phys_bno, void
     read_result = read(pvol->fd, buffer, vol->phys_blocksize);
     if (read_result != vol->phys_blocksize)
         return FSW_IO_ERROR;
+    pvol->host_reads++;
+    pvol->host_read_bytes += read_result;
+
+    return FSW_SUCCESS;
+}
+
+/**
+ * FSW interface function to read a run of consecutive blocks with a single system call.
+ * The buffer is provided by the core code.
+ */
+
+fsw_status_t fsw_posix_read_blocks(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer)
+{
+    struct fsw_posix_volume *pvol = (struct fsw_posix_volume *)vol->host_data;
+    off_t           block_offset;
+    ssize_t         read_result, read_size;
+
+    FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_posix_read_blocks: %d+%d  (%d)\n"), (int)phys_bno, count, vol->phys_blocksize));
+
+    block_offset = (off_t)phys_bno * vol->phys_blocksize;
+    read_size = (ssize_t)count * vol->phys_blocksize;
+    read_result = pread(pvol->fd, buffer, read_size, block_offset);
+    if (read_result != read_size)
+        return FSW_IO_ERROR;
+    pvol->host_reads++;
+    pvol->host_read_bytes += read_result;
 
     return FSW_SUCCESS;
 }
 
+/**
+ * FSW interface function to get a block without the core block cache. File data
+ * (cache level 0) is already cached by the operating system, so it is read into a
+ * buffer of our own instead of taking up space in the core cache. Metadata, and file
+ * data while the buffer is in use, is left to the core cache.
+ */
+
+fsw_status_t fsw_posix_block_get(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out)
+{
+    struct fsw_posix_volume *pvol = (struct fsw_posix_volume *)vol->host_data;
+    fsw_status_t    status;
+
+    if (cache_level > 0 || pvol->data_block_busy)
+        return FSW_UNSUPPORTED;
+
+    if (pvol->data_block != NULL && pvol->data_block_size < vol->phys_blocksize) {
+        fsw_free(pvol->data_block);
+        pvol->data_block = NULL;
+    }
+    if (pvol->data_block == NULL) {
+        status = fsw_alloc(vol->phys_blocksize, &pvol->data_block);
+        if (status)
+            return status;
+        pvol->data_block_size = vol->phys_blocksize;
+    }
+    status = fsw_posix_read_block(vol, phys_bno, pvol->data_block);
+    if (status)
+        return status;
+
+    pvol->data_block_busy = 1;
+    *buffer_out = pvol->data_block;
+    return FSW_SUCCESS;
+}
+
+/**
+ * FSW interface function to release a block. Only the data block buffer is ours;
+ * other blocks belong to the core block cache.
+ */
+
+fsw_status_t fsw_posix_block_release(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer)
+{
+    struct fsw_posix_volume *pvol = (struct fsw_posix_volume *)vol->host_data;
+
+    if (buffer != pvol->data_block || !pvol->data_block_busy)
+        return FSW_UNSUPPORTED;
+    pvol->data_block_busy = 0;
+    return FSW_SUCCESS;
+}
+
+/**
+ * FSW interface function returning a monotonic time in nanoseconds, used by the
+ * core to time host reads.
+ */
+
+fsw_u64 fsw_posix_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (fsw_u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 
 /**
  * Time mapping callback for the fsw_dnode_stat call. This function converts
@@ -54,6 +54,12 @@ struct fsw_posix_volume {
 
     int                         fd;             //!< System file descriptor for data access
 
+    void                        *data_block;    //!< Buffer for a file data block bypassing the block cache
+    fsw_u32                     data_block_size; //!< Size of the data_block buffer in bytes
+    int                         data_block_busy; //!< Whether data_block is handed out to the core
+
+    fsw_u64                     host_reads;     //!< Number of reads from the file/device
+    fsw_u64                     host_read_bytes; //!< Number of bytes read from the file/device
 };
 
 /**
@@ -83,6 +89,7 @@ struct fsw_posix_dir {
 
 struct fsw_posix_volume * fsw_posix_mount(const char *path, struct fsw_fstype_table *fstype_table);
 int fsw_posix_unmount(struct fsw_posix_volume *pvol);
+void fsw_posix_print_stats(struct fsw_posix_volume *pvol, FILE *out);
 
 struct fsw_posix_file * fsw_posix_open(struct fsw_posix_volume *pvol, const char *path, int flags, mode_t mode);
 ssize_t fsw_posix_read(struct fsw_posix_file *file, void *buf, size_t nbytes);
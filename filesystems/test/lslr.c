@@ -40,6 +40,8 @@
 
 #include "fsw_posix.h"
 
+#include <time.h>
+
 
 //extern struct fsw_fstype_table FSW_FSTYPE_TABLE_NAME(ext2);
 //extern struct fsw_fstype_table FSW_FSTYPE_TABLE_NAME(reiserfs);
@@ -105,13 +107,52 @@ static int catfile(struct fsw_posix_volume *vol, char *path)
     return 0;
 }
 
+static int readfile(struct fsw_posix_volume *vol, char *path, size_t chunk)
+{
+    struct fsw_posix_file *file;
+    struct timespec start, end;
+    char *buf;
+    ssize_t r;
+    fsw_u64 total = 0, reads, read_bytes;
+    double ms;
+
+    buf = malloc(chunk);
+    file = fsw_posix_open(vol, path, 0, 0);
+    if (buf == NULL || file == NULL) {
+        fprintf(stderr, "open(%s) call failed.\n", path);
+        free(buf);
+        return 1;
+    }
+
+    reads = vol->host_reads;
+    read_bytes = vol->host_read_bytes;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((r = fsw_posix_read(file, buf, chunk)) > 0)
+        total += r;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fsw_posix_close(file);
+    free(buf);
+
+    ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    fprintf(stderr, "%s: %llu bytes in %lu byte reads, %.1f ms (%.1f MB/s), %llu host reads of %llu bytes\n",
+            path, (unsigned long long)total, (unsigned long)chunk, ms, ms > 0 ? total / ms / 1e3 : 0.0,
+            (unsigned long long)(vol->host_reads - reads),
+            (unsigned long long)(vol->host_read_bytes - read_bytes));
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     struct fsw_posix_volume *vol;
-    int i;
+    int i, verbose = 0;
 
-    if (argc != 2) {
-        fprintf(stderr, "Usage: lslr <file/device>\n");
+    if (argc > 1 && strcmp(argv[1], "-v") == 0) {
+        verbose = 1;
+        argc--;
+        argv++;
+    }
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Usage: lslr [-v] <file/device> [<file to read> [<read size>]]\n");
         return 1;
     }
 
@@ -129,6 +170,10 @@ int main(int argc, char **argv)
 
     listdir(vol, "/boot/", 0);
     catfile(vol, "/boot/testfile.txt");
+    if (argc > 2)
+        readfile(vol, argv[2], argc > 3 ? (size_t)atol(argv[3]) : 4096);
+    if (verbose)
+        fsw_posix_print_stats(vol, stderr);
 
     fsw_posix_unmount(vol);
 
@@ -0,0 +1,150 @@
+/**
+ * \file strbench.c
+ * Micro-benchmark for name comparisons in the POSIX user space environment.
+ *
+ * Scans a list of ISO 8859-1 names, as a directory lookup in an ext2, ext4 or
+ * reiserfs volume does, for a name given in UTF-16 (the way the EFI host passes
+ * it) and in ISO 8859-1. Each scan is timed with plain fsw_streq calls, with a
+ * key prepared by fsw_strkey_init, and with precomputed fsw_strhash values as
+ * a cache of names would use them.
+ */
+
+/*-
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "fsw_posix.h"
+
+#include <time.h>
+
+#define BENCH_NAMES     (10000)
+#define BENCH_LOOKUPS   (200)
+#define BENCH_NAMELEN   (32)
+
+static char    names[BENCH_NAMES][BENCH_NAMELEN];
+static struct fsw_string entries[BENCH_NAMES];
+static fsw_u32 hashes[BENCH_NAMES];
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void make_lookup(struct fsw_string *s, int type, int n, fsw_u16 *buffer16, char *buffer8)
+{
+    int i, len;
+
+    len = snprintf(buffer8, BENCH_NAMELEN, "vmlinuz-%05d", n);
+    s->type = type;
+    s->len = len;
+    if (type == FSW_STRING_TYPE_UTF16) {
+        for (i = 0; i < len; i++)
+            buffer16[i] = (fsw_u8)buffer8[i];
+        s->size = len * sizeof(fsw_u16);
+        s->data = buffer16;
+    } else {
+        s->size = len;
+        s->data = buffer8;
+    }
+}
+
+static void bench_type(int type, const char *type_name)
+{
+    struct fsw_string lookup;
+    struct fsw_string_key key;
+    fsw_u16         buffer16[BENCH_NAMELEN];
+    char            buffer8[BENCH_NAMELEN];
+    fsw_u32         hash;
+    int             i, n, found[3];
+    double          start, elapsed[3];
+
+    found[0] = found[1] = found[2] = 0;
+
+    // plain fsw_streq against every entry
+    start = now_ns();
+    for (n = 0; n < BENCH_LOOKUPS; n++) {
+        make_lookup(&lookup, type, n * 37 % BENCH_NAMES, buffer16, buffer8);
+        for (i = 0; i < BENCH_NAMES; i++)
+            found[0] += fsw_streq(&lookup, &entries[i]);
+    }
+    elapsed[0] = now_ns() - start;
+
+    // prepared key
+    start = now_ns();
+    for (n = 0; n < BENCH_LOOKUPS; n++) {
+        make_lookup(&lookup, type, n * 37 % BENCH_NAMES, buffer16, buffer8);
+        if (fsw_strkey_init(&key, FSW_STRING_TYPE_ISO88591, &lookup))
+            return;
+        for (i = 0; i < BENCH_NAMES; i++)
+            found[1] += fsw_strkey_eq(&key, &entries[i]);
+        fsw_strkey_free(&key);
+    }
+    elapsed[1] = now_ns() - start;
+
+    // precomputed hashes, full compare only on a hash match
+    start = now_ns();
+    for (n = 0; n < BENCH_LOOKUPS; n++) {
+        make_lookup(&lookup, type, n * 37 % BENCH_NAMES, buffer16, buffer8);
+        hash = fsw_strhash(&lookup);
+        for (i = 0; i < BENCH_NAMES; i++) {
+            if (hashes[i] == hash)
+                found[2] += fsw_streq(&lookup, &entries[i]);
+        }
+    }
+    elapsed[2] = now_ns() - start;
+
+    printf("%-10s lookups: fsw_streq %5.2f ns, fsw_strkey_eq %5.2f ns, hash %5.2f ns per entry (%d/%d/%d found)\n",
+           type_name,
+           elapsed[0] / ((double)BENCH_LOOKUPS * BENCH_NAMES),
+           elapsed[1] / ((double)BENCH_LOOKUPS * BENCH_NAMES),
+           elapsed[2] / ((double)BENCH_LOOKUPS * BENCH_NAMES),
+           found[0], found[1], found[2]);
+}
+
+int main(int argc, char **argv)
+{
+    int i, len;
+
+    // names like those in a boot directory, many with the same length
+    for (i = 0; i < BENCH_NAMES; i++) {
+        if (i % 4 == 3)
+            len = snprintf(names[i], BENCH_NAMELEN, "initrd.img-%05d", i);
+        else
+            len = snprintf(names[i], BENCH_NAMELEN, "vmlinuz-%05d", i);
+        entries[i].type = FSW_STRING_TYPE_ISO88591;
+        entries[i].len = entries[i].size = len;
+        entries[i].data = names[i];
+        hashes[i] = fsw_strhash(&entries[i]);
+    }
+
+    bench_type(FSW_STRING_TYPE_UTF16, "UTF-16");
+    bench_type(FSW_STRING_TYPE_ISO88591, "ISO-8859-1");
+    return 0;
+}
+
+// EOF